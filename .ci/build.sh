@@ -7,6 +7,7 @@ pacman -S --noconfirm --needed git cmake lxqt-build-tools qt6-tools python-pyqt6
 
 cmake -B build -S . \
     -DBUILD_EXAMPLE=ON \
+    -DBUILD_BENCHMARKS=ON \
     -DQTERMWIDGET_USE_UTEMPTER=ON
 make -C build
 
@@ -0,0 +1,143 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "BenchmarkUtils.h"
+
+// Standard Library
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+// Qt
+#include <QFile>
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+namespace
+{
+std::atomic<quint64> allocations(0);
+
+inline void countAllocation()
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+}
+
+#if defined(__GLIBC__)
+
+// replace the allocator entry points of the C library, which also catches
+// operator new and the allocations of QArrayData
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+}
+
+#else
+
+void* operator new(std::size_t size)
+{
+    countAllocation();
+    if (void* pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+#endif
+
+quint64 Benchmark::allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+qint64 Benchmark::residentMemory()
+{
+#if defined(Q_OS_LINUX)
+    // the second field is the number of resident pages
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+double Benchmark::percentile(QVector<double> samples, double percent)
+{
+    if (samples.isEmpty())
+        return 0;
+
+    std::sort(samples.begin(), samples.end());
+    const int rank = static_cast<int>(std::ceil(percent / 100.0 * samples.size()));
+    return samples.at(qBound(0, rank - 1, int(samples.size()) - 1));
+}
+
+void Benchmark::appendUtf8(QByteArray& out, uint codePoint)
+{
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xc0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xe0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+}
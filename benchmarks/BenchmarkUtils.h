@@ -0,0 +1,76 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef BENCHMARKUTILS_H
+#define BENCHMARKUTILS_H
+
+// Qt
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+namespace Benchmark
+{
+
+/**
+ * Returns the number of heap allocations made by the process so far.
+ *
+ * With glibc every call to malloc(), calloc() and realloc() is counted,
+ * which includes the allocations made by Qt containers.  Elsewhere only
+ * the global operator new is counted.
+ */
+quint64 allocationCount();
+
+/**
+ * Returns the resident memory of the process in bytes, or -1 if it is not
+ * known on this platform.
+ */
+qint64 residentMemory();
+
+/** Small deterministic random number generator (xorshift64*). */
+class Random
+{
+public:
+    explicit Random(quint64 seed = 0x2545f4914f6cdd1dULL) : _state(seed ? seed : 1) {}
+
+    quint64 next()
+    {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545f4914f6cdd1dULL;
+    }
+
+    /** Returns a number in the range [0, bound) */
+    int bounded(int bound) { return static_cast<int>(next() % static_cast<quint64>(bound)); }
+
+private:
+    quint64 _state;
+};
+
+/**
+ * Returns the @p percent percentile of @p samples, using the nearest rank.
+ * Returns 0 if there are no samples.
+ */
+double percentile(QVector<double> samples, double percent);
+
+/** Appends the UTF-8 encoding of @p codePoint to @p out. */
+void appendUtf8(QByteArray& out, uint codePoint);
+
+}
+
+#endif // BENCHMARKUTILS_H
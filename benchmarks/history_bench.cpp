@@ -0,0 +1,247 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+    Compares the history backends: how fast lines are appended, the
+    latency of reading a random line, the speed of scrolling back through
+    the whole history and the resident memory they need.
+
+    Each backend and line mix is measured in a process of its own, so the
+    memory left behind by one run does not hide the cost of the next.
+*/
+
+#include <cstdio>
+#include <memory>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QVector>
+
+#include "BenchmarkUtils.h"
+#include "History.h"
+
+using namespace Konsole;
+
+namespace
+{
+
+const int LinePoolSize = 64;
+const int ScrollBackPage = 50;
+
+enum LineKind { BlankLine, ShortLine, ColoredLine };
+
+QVector<Character> makeLine(LineKind kind, Benchmark::Random& random)
+{
+    QVector<Character> line;
+    if (kind == ShortLine) {
+        // a line of log output in the default colors
+        const int length = 20 + random.bounded(40);
+        for (int i = 0; i < length; i++)
+            line << Character(static_cast<quint16>(' ' + 1 + random.bounded(94)));
+    } else if (kind == ColoredLine) {
+        // 200 columns of syntax highlighted text, the colors change every few cells
+        CharacterColor foreground(COLOR_SPACE_DEFAULT, DEFAULT_FORE_COLOR);
+        CharacterColor background(COLOR_SPACE_DEFAULT, DEFAULT_BACK_COLOR);
+        quint16 rendition = DEFAULT_RENDITION;
+        for (int i = 0; i < 200; i++) {
+            if (i % 8 == 0) {
+                foreground = CharacterColor(COLOR_SPACE_256, random.bounded(256));
+                if (random.bounded(4) == 0)
+                    background = CharacterColor(COLOR_SPACE_256, random.bounded(256));
+                rendition = random.bounded(3) == 0 ? RE_BOLD : DEFAULT_RENDITION;
+            }
+            line << Character(static_cast<quint16>('a' + random.bounded(26)), foreground, background, rendition);
+        }
+    }
+    return line;
+}
+
+struct LineMix
+{
+    const char* name;
+    // percentage of blank, short and colored lines
+    int blank;
+    int shortLines;
+    int colored;
+};
+
+const LineMix lineMixes[] = {
+    { "realistic", 20, 65, 15 },
+    { "blank", 100, 0, 0 },
+    { "short", 0, 100, 0 },
+    { "colored", 0, 0, 100 },
+};
+
+std::unique_ptr<HistoryType> createHistoryType(const QString& backend, int lines)
+{
+    if (backend == QLatin1String("buffer"))
+        return std::make_unique<HistoryTypeBuffer>(lines);
+    if (backend == QLatin1String("file"))
+        return std::make_unique<HistoryTypeFile>();
+    if (backend == QLatin1String("compressed"))
+        return std::make_unique<CompressedHistoryType>(lines);
+#ifndef Q_OS_WIN
+    if (backend == QLatin1String("compact"))
+        return std::make_unique<CompactHistoryType>(lines);
+    if (backend == QLatin1String("blockarray"))
+        return std::make_unique<HistoryTypeBlockArray>(lines);
+#endif
+    return nullptr;
+}
+
+QStringList backends()
+{
+    QStringList names;
+    names << QStringLiteral("buffer") << QStringLiteral("file") << QStringLiteral("compressed");
+#ifndef Q_OS_WIN
+    names << QStringLiteral("compact") << QStringLiteral("blockarray");
+#endif
+    return names;
+}
+
+int runBackend(const QString& backend, const LineMix& mix, int lines, int reads)
+{
+    const std::unique_ptr<HistoryType> type = createHistoryType(backend, lines);
+    if (!type) {
+        fprintf(stderr, "Unknown backend %s\n", qPrintable(backend));
+        return 1;
+    }
+
+    // build the lines up front, so that appending measures only the backend
+    Benchmark::Random random;
+    QVector<QVector<Character>> pool;
+    QVector<bool> wrapped;
+    for (int i = 0; i < LinePoolSize; i++) {
+        const int percent = random.bounded(100);
+        const LineKind kind = percent < mix.blank ? BlankLine
+                            : percent < mix.blank + mix.shortLines ? ShortLine
+                            : ColoredLine;
+        pool << makeLine(kind, random);
+        wrapped << (kind == ColoredLine && random.bounded(10) == 0);
+    }
+
+    const qint64 memoryBefore = Benchmark::residentMemory();
+    std::unique_ptr<HistoryScroll> history(type->scroll(nullptr));
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < lines; i++) {
+        const int index = random.bounded(LinePoolSize);
+        history->addCellsVector(pool.at(index));
+        history->addLine(wrapped.at(index));
+    }
+    const double appendSeconds = timer.nsecsElapsed() / 1e9;
+    const qint64 memoryAfter = Benchmark::residentMemory();
+
+    const int storedLines = history->getLines();
+    QVector<Character> buffer(1024);
+
+    // random access, as when jumping to a search result
+    QVector<double> latencies;
+    latencies.reserve(reads);
+    for (int i = 0; i < reads && storedLines > 0; i++) {
+        const int line = random.bounded(storedLines);
+        timer.restart();
+        const int length = qMin(history->getLineLen(line), int(buffer.size()));
+        history->getCells(line, 0, length, buffer.data());
+        latencies << timer.nsecsElapsed();
+    }
+
+    // scrolling back page by page from the end of the history
+    timer.restart();
+    for (int page = storedLines; page > 0; page -= ScrollBackPage) {
+        for (int line = qMax(0, page - ScrollBackPage); line < page; line++) {
+            const int length = qMin(history->getLineLen(line), int(buffer.size()));
+            history->getCells(line, 0, length, buffer.data());
+        }
+    }
+    const double scrollBackSeconds = timer.nsecsElapsed() / 1e9;
+
+    char memory[32] = "n/a";
+    if (memoryBefore >= 0 && memoryAfter >= 0) {
+        snprintf(memory, sizeof(memory), "%.1f",
+                 (memoryAfter - memoryBefore) / (1024.0 * 1024.0) * (1e6 / lines));
+    }
+
+    printf("%-11s %-10s %9d %12.0f %10.0f %10.0f %12.0f %14s\n",
+           qPrintable(backend), mix.name, storedLines,
+           lines / appendSeconds,
+           Benchmark::percentile(latencies, 50), Benchmark::percentile(latencies, 99),
+           storedLines / qMax(scrollBackSeconds, 1e-9),
+           memory);
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Compares the history backends."));
+    parser.addHelpOption();
+    parser.addOption({QStringLiteral("lines"), QStringLiteral("Number of lines appended to each backend."),
+                      QStringLiteral("count"), QStringLiteral("200000")});
+    parser.addOption({QStringLiteral("reads"), QStringLiteral("Number of random line reads."),
+                      QStringLiteral("count"), QStringLiteral("100000")});
+    parser.addOption({QStringLiteral("mix"), QStringLiteral("Line mix: realistic, blank, short, colored or all."),
+                      QStringLiteral("name"), QStringLiteral("all")});
+    parser.addOption({QStringLiteral("backend"), QStringLiteral("Measure only this backend, in this process: %1.")
+                                                     .arg(backends().join(QLatin1String(", "))),
+                      QStringLiteral("name")});
+    parser.process(app);
+
+    const int lines = qMax(1, parser.value(QStringLiteral("lines")).toInt());
+    const int reads = qMax(0, parser.value(QStringLiteral("reads")).toInt());
+    const QString mixName = parser.value(QStringLiteral("mix"));
+
+    if (parser.isSet(QStringLiteral("backend"))) {
+        for (const LineMix& mix : lineMixes) {
+            if (mixName == QLatin1String(mix.name))
+                return runBackend(parser.value(QStringLiteral("backend")), mix, lines, reads);
+        }
+        fprintf(stderr, "Unknown line mix %s\n", qPrintable(mixName));
+        return 1;
+    }
+
+    printf("%-11s %-10s %9s %12s %10s %10s %12s %14s\n", "backend", "mix", "lines",
+           "append/s", "read p50", "read p99", "scrollback/s", "RSS MiB/Mline");
+    printf("%-11s %-10s %9s %12s %10s %10s %12s %14s\n", "", "", "", "", "ns", "ns", "", "");
+    fflush(stdout);
+
+    for (const QString& backend : backends()) {
+        for (const LineMix& mix : lineMixes) {
+            if (mixName != QLatin1String("all") && mixName != QLatin1String(mix.name))
+                continue;
+
+            QProcess child;
+            child.setProcessChannelMode(QProcess::ForwardedChannels);
+            child.start(QCoreApplication::applicationFilePath(),
+                        { QStringLiteral("--backend"), backend,
+                          QStringLiteral("--mix"), QLatin1String(mix.name),
+                          QStringLiteral("--lines"), QString::number(lines),
+                          QStringLiteral("--reads"), QString::number(reads) });
+            if (!child.waitForFinished(-1) || child.exitCode() != 0)
+                return 1;
+        }
+    }
+
+    return 0;
+}
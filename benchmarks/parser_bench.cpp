@@ -0,0 +1,306 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+    Measures how fast Vt102Emulation::receiveData() consumes typical
+    terminal output, without any view attached.
+
+    Built-in streams are generated for a number of workloads.  Captured
+    output, e.g. from `script -q /dev/null`, can be replayed by passing the
+    files on the command line.
+*/
+
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+
+#include "BenchmarkUtils.h"
+#include "History.h"
+#include "Vt102Emulation.h"
+
+using namespace Konsole;
+
+namespace
+{
+
+const int ScreenLines = 50;
+const int ScreenColumns = 200;
+
+struct Workload
+{
+    QString name;
+    QByteArray data;
+};
+
+typedef void (*Generator)(QByteArray& out, Benchmark::Random& random);
+
+void generateAsciiLog(QByteArray& out, Benchmark::Random& random)
+{
+    static const char* const levels[] = { "DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR" };
+    static const char* const messages[] = {
+        "processed request", "cache miss for key", "connection accepted from",
+        "flushing write-ahead log segment", "retrying upstream call to"
+    };
+
+    char line[256];
+    const int length = snprintf(line, sizeof(line),
+                                "2024-05-%02d %02d:%02d:%02d.%03d %-5s [worker-%d] %s %d in %d ms\r\n",
+                                random.bounded(28) + 1, random.bounded(24), random.bounded(60),
+                                random.bounded(60), random.bounded(1000), levels[random.bounded(6)],
+                                random.bounded(16), messages[random.bounded(5)],
+                                random.bounded(1000000), random.bounded(500));
+    out.append(line, length);
+}
+
+void generateTrueColor(QByteArray& out, Benchmark::Random& random)
+{
+    char sequence[64];
+    for (int column = 0; column < 80; column++) {
+        const int length = snprintf(sequence, sizeof(sequence), "\033[38;2;%d;%d;%d;48;2;%d;%d;%dm%c",
+                                    random.bounded(256), random.bounded(256), random.bounded(256),
+                                    random.bounded(256), random.bounded(256), random.bounded(256),
+                                    'A' + random.bounded(26));
+        out.append(sequence, length);
+    }
+    out.append("\033[0m\r\n");
+}
+
+void generateCjk(QByteArray& out, Benchmark::Random& random)
+{
+    // CJK unified ideographs are double width, 60 of them fill most of a line
+    for (int i = 0; i < 60; i++) {
+        if (random.bounded(10) == 0)
+            out += "\xe3\x80\x81"; // ideographic comma
+        else
+            Benchmark::appendUtf8(out, 0x4e00 + random.bounded(0x5000));
+    }
+    out += "\r\n";
+}
+
+void generateEmoji(QByteArray& out, Benchmark::Random& random)
+{
+    for (int i = 0; i < 30; i++) {
+        switch (random.bounded(5)) {
+        case 0: // family, joined with zero width joiners
+            out += "\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9\xe2\x80\x8d\xf0\x9f\x91\xa7";
+            break;
+        case 1: // thumbs up with a skin tone modifier
+            out += "\xf0\x9f\x91\x8d";
+            Benchmark::appendUtf8(out, 0x1f3fb + random.bounded(5));
+            break;
+        case 2: // heart with variation selector 16
+            out += "\xe2\x9d\xa4\xef\xb8\x8f";
+            break;
+        case 3: // flag, a pair of regional indicators
+            Benchmark::appendUtf8(out, 0x1f1e6 + random.bounded(26));
+            Benchmark::appendUtf8(out, 0x1f1e6 + random.bounded(26));
+            break;
+        default:
+            out += " ok ";
+            break;
+        }
+    }
+    out += "\r\n";
+}
+
+void generateTuiRedraw(QByteArray& out, Benchmark::Random& random)
+{
+    // one full redraw of a boxed, colored TUI screen by cursor addressing
+    char sequence[64];
+    out += "\033[H\033[38;5;244m\xe2\x94\x8c";
+    for (int column = 1; column < ScreenColumns - 1; column++)
+        out += "\xe2\x94\x80";
+    out += "\xe2\x94\x90";
+
+    for (int line = 2; line < ScreenLines; line++) {
+        int length = snprintf(sequence, sizeof(sequence), "\033[%d;1H\033[38;5;244m\xe2\x94\x82", line);
+        out.append(sequence, length);
+        for (int cell = 0; cell < 6; cell++) {
+            length = snprintf(sequence, sizeof(sequence), "\033[%d;%dH\033[38;5;%d;48;5;%dm",
+                              line, 3 + cell * 32, random.bounded(256), random.bounded(256));
+            out.append(sequence, length);
+            for (int i = 0; i < 24; i++)
+                out += static_cast<char>('a' + random.bounded(26));
+        }
+        length = snprintf(sequence, sizeof(sequence), "\033[0m\033[%d;%dH\033[38;5;244m\xe2\x94\x82",
+                          line, ScreenColumns);
+        out.append(sequence, length);
+    }
+
+    int length = snprintf(sequence, sizeof(sequence), "\033[%d;1H\xe2\x94\x94", ScreenLines);
+    out.append(sequence, length);
+    for (int column = 1; column < ScreenColumns - 1; column++)
+        out += "\xe2\x94\x80";
+    out += "\xe2\x94\x98\033[0m";
+}
+
+void generateScrollRegion(QByteArray& out, Benchmark::Random& random)
+{
+    // a status line at the top and bottom with a scrolling region between
+    char sequence[128];
+    int length = snprintf(sequence, sizeof(sequence), "\033[2;%dr\033[%d;1H", ScreenLines - 1, ScreenLines - 1);
+    out.append(sequence, length);
+
+    for (int i = 0; i < 20; i++) {
+        switch (random.bounded(8)) {
+        case 0:
+            out += "\033[5;1H\033[3L"; // insert lines
+            break;
+        case 1:
+            out += "\033[5;1H\033[2M"; // delete lines
+            break;
+        case 2:
+            out += "\033[2;1H\033M"; // reverse index at the top of the region
+            break;
+        default:
+            length = snprintf(sequence, sizeof(sequence), "\033[%d;1Hcompiling module %d of 4000\r\n",
+                              ScreenLines - 1, random.bounded(4000));
+            out.append(sequence, length);
+            break;
+        }
+    }
+
+    length = snprintf(sequence, sizeof(sequence), "\033[r\033[%d;1H\033[7m status %d \033[0m",
+                      ScreenLines, random.bounded(100));
+    out.append(sequence, length);
+}
+
+QByteArray generate(Generator generator, int size)
+{
+    Benchmark::Random random;
+    QByteArray data;
+    data.reserve(size + 64 * 1024);
+    while (data.size() < size)
+        generator(data, random);
+    return data;
+}
+
+struct Result
+{
+    double seconds;
+    quint64 allocations;
+};
+
+Result run(const QByteArray& data, Vt102Emulation::ParserType parserType, int chunkSize)
+{
+    Vt102Emulation emulation;
+    emulation.setParserType(parserType);
+    emulation.setImageSize(ScreenLines, ScreenColumns);
+    emulation.setHistory(HistoryTypeBuffer(1000));
+
+    // warm up the history and the buffers of the emulation
+    const int warmUp = qMin<int>(data.size(), 256 * 1024);
+    for (int offset = 0; offset < warmUp; offset += chunkSize)
+        emulation.receiveData(data.constData() + offset, qMin(chunkSize, warmUp - offset));
+    emulation.reset();
+
+    const quint64 allocationsBefore = Benchmark::allocationCount();
+    QElapsedTimer timer;
+    timer.start();
+
+    // feed the data in blocks like the ones read from a pty
+    for (int offset = 0; offset < data.size(); offset += chunkSize)
+        emulation.receiveData(data.constData() + offset, qMin(chunkSize, int(data.size()) - offset));
+
+    Result result;
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.allocations = Benchmark::allocationCount() - allocationsBefore;
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the throughput of the terminal emulation."));
+    parser.addHelpOption();
+    parser.addOption({QStringLiteral("size"), QStringLiteral("Size of each generated stream in MiB."),
+                      QStringLiteral("mib"), QStringLiteral("16")});
+    parser.addOption({QStringLiteral("chunk"), QStringLiteral("Number of bytes passed to receiveData() at once."),
+                      QStringLiteral("bytes"), QStringLiteral("4096")});
+    parser.addOption({QStringLiteral("repeat"), QStringLiteral("Number of runs, the fastest is reported."),
+                      QStringLiteral("count"), QStringLiteral("3")});
+    parser.addOption({QStringLiteral("parser"), QStringLiteral("Parser to measure: tokenizer, statemachine or both."),
+                      QStringLiteral("type"), QStringLiteral("both")});
+    parser.addPositionalArgument(QStringLiteral("files"),
+                                 QStringLiteral("Captured terminal output to replay instead of the built-in streams."),
+                                 QStringLiteral("[files...]"));
+    parser.process(app);
+
+    const int size = qMax(1, parser.value(QStringLiteral("size")).toInt()) * 1024 * 1024;
+    const int chunkSize = qMax(1, parser.value(QStringLiteral("chunk")).toInt());
+    const int repeat = qMax(1, parser.value(QStringLiteral("repeat")).toInt());
+
+    QList<Vt102Emulation::ParserType> parserTypes;
+    const QString parserName = parser.value(QStringLiteral("parser"));
+    if (parserName != QLatin1String("statemachine"))
+        parserTypes << Vt102Emulation::TokenizerParser;
+    if (parserName != QLatin1String("tokenizer"))
+        parserTypes << Vt102Emulation::StateMachineParser;
+
+    QList<Workload> workloads;
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        workloads << Workload{QStringLiteral("ascii-log"), generate(generateAsciiLog, size)}
+                  << Workload{QStringLiteral("sgr-truecolor"), generate(generateTrueColor, size)}
+                  << Workload{QStringLiteral("cjk"), generate(generateCjk, size)}
+                  << Workload{QStringLiteral("emoji-zwj"), generate(generateEmoji, size)}
+                  << Workload{QStringLiteral("tui-redraw"), generate(generateTuiRedraw, size)}
+                  << Workload{QStringLiteral("scroll-region"), generate(generateScrollRegion, size)};
+    }
+    for (const QString& fileName : files) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "Cannot read %s\n", qPrintable(fileName));
+            return 1;
+        }
+        workloads << Workload{QFileInfo(fileName).fileName(), file.readAll()};
+    }
+
+    printf("%-20s %-13s %10s %10s %12s %12s\n",
+           "workload", "parser", "MiB", "MiB/s", "ns/byte", "allocs/MiB");
+
+    for (const Workload& workload : std::as_const(workloads)) {
+        const double mebibytes = workload.data.size() / (1024.0 * 1024.0);
+        for (Vt102Emulation::ParserType parserType : std::as_const(parserTypes)) {
+            Result best = run(workload.data, parserType, chunkSize);
+            for (int i = 1; i < repeat; i++) {
+                const Result result = run(workload.data, parserType, chunkSize);
+                if (result.seconds < best.seconds)
+                    best = result;
+            }
+
+            printf("%-20s %-13s %10.1f %10.1f %12.2f %12.1f\n",
+                   qPrintable(workload.name),
+                   parserType == Vt102Emulation::TokenizerParser ? "tokenizer" : "statemachine",
+                   mebibytes,
+                   mebibytes / best.seconds,
+                   best.seconds * 1e9 / qMax<qsizetype>(1, workload.data.size()),
+                   best.allocations / qMax(mebibytes, 1e-9));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+/*
+    Measures the cost of turning emulation output into pixels: the update
+    of TerminalDisplay's image after a change and the paint event that
+    follows, for a number of typical kinds of updates.
+
+    The output of each frame is parsed before the clock starts, so parsing
+    is not part of the numbers, see qtermwidget_parser_bench for that.
+    Runs on the offscreen platform unless QT_QPA_PLATFORM is set.
+*/
+
+#include <cstdio>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFontDatabase>
+#include <QPaintEvent>
+
+#include "BenchmarkUtils.h"
+#include "ScreenWindow.h"
+#include "TerminalDisplay.h"
+#include "Vt102Emulation.h"
+
+using namespace Konsole;
+
+namespace
+{
+
+const int ScreenLines = 50;
+const int ScreenColumns = 160;
+
+/** Counts the cells covered by the paint events of the display */
+class PaintCounter : public QObject
+{
+public:
+    explicit PaintCounter(TerminalDisplay* display) : _display(display), _cells(0)
+    {
+        display->installEventFilter(this);
+    }
+
+    qint64 takeCells()
+    {
+        const qint64 cells = _cells;
+        _cells = 0;
+        return cells;
+    }
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override
+    {
+        if (watched == _display && event->type() == QEvent::Paint) {
+            const int cellArea = qMax(1, _display->fontWidth() * _display->fontHeight());
+            for (const QRect& rect : static_cast<QPaintEvent*>(event)->region())
+                _cells += qint64(rect.width()) * rect.height() / cellArea;
+        }
+        return false;
+    }
+
+private:
+    TerminalDisplay* _display;
+    qint64 _cells;
+};
+
+/** Returns the output of frame @p frame of a scenario, or an empty array for no output */
+typedef QByteArray (*Scenario)(int frame, Benchmark::Random& random);
+
+QByteArray fullScreenScroll(int frame, Benchmark::Random& random)
+{
+    // one full width line per frame, scrolling the whole screen
+    QByteArray line = QByteArray::number(frame).rightJustified(8) + ' ';
+    while (line.size() < ScreenColumns)
+        line += static_cast<char>('a' + random.bounded(26));
+    return line + "\r\n";
+}
+
+QByteArray singleLineChange(int frame, Benchmark::Random& random)
+{
+    // typing at a prompt on the last line
+    if (frame % 60 == 0)
+        return "\r\033[K$ ";
+    return QByteArray(1, static_cast<char>('a' + random.bounded(26)));
+}
+
+QByteArray cursorBlink(int, Benchmark::Random&)
+{
+    // no output, the cursor is toggled by the frame loop
+    return QByteArray();
+}
+
+QByteArray colorGradient(int frame, Benchmark::Random&)
+{
+    // every cell with a different background out of the 256 color palette
+    QByteArray out = "\033[H";
+    for (int line = 0; line < ScreenLines; line++) {
+        for (int column = 0; column < ScreenColumns; column++)
+            out += "\033[48;5;" + QByteArray::number((line + column + frame) % 256) + "m ";
+        out += "\033[0m";
+        if (line < ScreenLines - 1)
+            out += "\r\n";
+    }
+    return out;
+}
+
+QByteArray boxDrawingTui(int frame, Benchmark::Random& random)
+{
+    // a grid of boxes, redrawn each frame with new values inside
+    QByteArray out = "\033[H";
+    for (int line = 0; line < ScreenLines; line++) {
+        const bool border = line % 5 == 0;
+        for (int column = 0; column < ScreenColumns; column++) {
+            if (column % 20 == 0)
+                out += border ? "\xe2\x94\xbc" : "\xe2\x94\x82";
+            else if (border)
+                out += "\xe2\x94\x80";
+            else if (column % 20 < 8)
+                out += static_cast<char>('0' + (random.bounded(10) + frame) % 10);
+            else
+                out += ' ';
+        }
+        if (line < ScreenLines - 1)
+            out += "\r\n";
+    }
+    return out;
+}
+
+QByteArray wideCjk(int frame, Benchmark::Random& random)
+{
+    // a screen full of double width characters
+    QByteArray out = "\033[H";
+    for (int line = 0; line < ScreenLines; line++) {
+        for (int column = 0; column < ScreenColumns / 2; column++)
+            Benchmark::appendUtf8(out, 0x4e00 + (random.bounded(0x5000) + frame) % 0x5000);
+        if (line < ScreenLines - 1)
+            out += "\r\n";
+    }
+    return out;
+}
+
+struct Samples
+{
+    QVector<double> update;
+    QVector<double> paint;
+    QVector<double> frame;
+    qint64 cells = 0;
+};
+
+Samples run(Scenario scenario, bool blink, int frames)
+{
+    Vt102Emulation emulation;
+    TerminalDisplay display;
+    display.setVTFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    display.setFixedSize(ScreenColumns, ScreenLines);
+    display.setScreenWindow(emulation.createWindow());
+    emulation.setImageSize(ScreenLines, ScreenColumns);
+    display.show();
+    QCoreApplication::processEvents();
+
+    PaintCounter counter(&display);
+    Benchmark::Random random;
+    Samples samples;
+
+    for (int frame = -10; frame < frames; frame++) {
+        const QByteArray output = scenario(frame, random);
+        if (!output.isEmpty())
+            emulation.receiveData(output.constData(), output.size());
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // what the frame timer of the emulation would trigger
+        if (blink)
+            QMetaObject::invokeMethod(&display, "blinkCursorEvent");
+        else
+            QMetaObject::invokeMethod(&emulation, "showBulk");
+        const qint64 updated = timer.nsecsElapsed();
+
+        // deliver the pending update request, which paints synchronously
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::UpdateRequest);
+        const qint64 painted = timer.nsecsElapsed();
+
+        const qint64 cells = counter.takeCells();
+        if (frame < 0)
+            continue; // warming up
+
+        samples.update << updated / 1e3;
+        samples.paint << (painted - updated) / 1e3;
+        samples.frame << painted / 1e3;
+        samples.cells += cells;
+    }
+
+    return samples;
+}
+
+void report(const char* name, const char* phase, const QVector<double>& samples)
+{
+    printf("%-18s %-7s %9.1f %9.1f %9.1f %9.1f",
+           name, phase,
+           Benchmark::percentile(samples, 50), Benchmark::percentile(samples, 90),
+           Benchmark::percentile(samples, 99), Benchmark::percentile(samples, 100));
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the update and paint cost of TerminalDisplay."));
+    parser.addHelpOption();
+    parser.addOption({QStringLiteral("frames"), QStringLiteral("Number of frames per scenario."),
+                      QStringLiteral("count"), QStringLiteral("500")});
+    parser.process(app);
+
+    const int frames = qMax(1, parser.value(QStringLiteral("frames")).toInt());
+
+    struct {
+        const char* name;
+        Scenario scenario;
+        bool blink;
+    } const scenarios[] = {
+        { "full-scroll", fullScreenScroll, false },
+        { "single-line", singleLineChange, false },
+        { "cursor-blink", cursorBlink, true },
+        { "256-color", colorGradient, false },
+        { "box-drawing-tui", boxDrawingTui, false },
+        { "wide-cjk", wideCjk, false },
+    };
+
+    printf("%d x %d cells, %d frames, times in microseconds\n", ScreenColumns, ScreenLines, frames);
+    printf("%-18s %-7s %9s %9s %9s %9s %12s\n", "scenario", "phase", "p50", "p90", "p99", "max", "cells/frame");
+
+    for (const auto& entry : scenarios) {
+        const Samples samples = run(entry.scenario, entry.blink, frames);
+        report(entry.name, "update", samples.update);
+        printf("\n");
+        report(entry.name, "paint", samples.paint);
+        printf("\n");
+        report(entry.name, "frame", samples.frame);
+        printf(" %12.1f\n", double(samples.cells) / frames);
+    }
+
+    return 0;
+}
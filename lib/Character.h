@@ -25,10 +25,12 @@
 
 // Qt
 #include <QHash>
+#include <QMutex>
 #include <QSet>
 
 // Local
 #include "CharacterColor.h"
+#include "qtermwidget_core_export.h"
 
 namespace Konsole
 {
@@ -75,7 +77,7 @@ public:
   inline Character(quint16 _c = ' ',
             CharacterColor  _f = CharacterColor(COLOR_SPACE_DEFAULT,DEFAULT_FORE_COLOR),
             CharacterColor  _b = CharacterColor(COLOR_SPACE_DEFAULT,DEFAULT_BACK_COLOR),
-            quint8  _r = DEFAULT_RENDITION)
+            quint16 _r = DEFAULT_RENDITION)
        : character(_c), rendition(_r), foregroundColor(_f), backgroundColor(_b) {}
 
   /** The unicode character value for this character.
@@ -86,7 +88,7 @@ public:
   wchar_t character;
 
   /** A combination of RENDITION flags which specify options for drawing the character. */
-  quint8  rendition;
+  quint16 rendition;
 
   /** The foreground color used to draw this character. */
   CharacterColor  foregroundColor;
@@ -174,6 +176,7 @@ inline ColorEntry::FontWeight Character::fontWeight(const ColorEntry* base) cons
         return ColorEntry::UseCurrentFormat;
 }
 
+// the VT100 graphics character set, defined in Vt102Emulation.cpp
 extern unsigned short vt100_graphics[32];
 
 
@@ -183,7 +186,7 @@ extern unsigned short vt100_graphics[32];
  * character ( ushort ) so that it can occupy the same space in
  * a structure.
  */
-class ExtendedCharTable
+class QTERMWIDGET_CORE_EXPORT ExtendedCharTable
 {
 public:
     /** Constructs a new character table. */
@@ -220,6 +223,12 @@ public:
      */
     QSet<ScreenWindow*> windows;
 
+    /**
+     * Guards the table and windows.  Emulations running on worker threads
+     * (see Session::setThreadedEmulation()) add characters concurrently.
+     */
+    mutable QMutex mutex;
+
     /** The global ExtendedCharTable instance. */
     static ExtendedCharTable instance;
 private:
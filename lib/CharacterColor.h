@@ -25,6 +25,10 @@
 
 // Qt
 #include <QColor>
+#include <QDataStream>
+#include <QHashFunctions>
+
+#include "qtermwidget_core_export.h"
 
 //#include <kdemacros.h>
 #define KDE_NO_EXPORT
@@ -106,9 +110,9 @@ public:
 #define DEFAULT_BACK_COLOR 1
 
 //a standard set of colors using black text on a white background.
-//defined in TerminalDisplay.cpp
+//defined in ColorScheme.cpp
 
-extern const ColorEntry base_color_table[TABLE_COLORS] KDE_NO_EXPORT;
+extern QTERMWIDGET_CORE_EXPORT const ColorEntry base_color_table[TABLE_COLORS];
 
 /* CharacterColor is a union of the various color spaces.
 
@@ -222,6 +226,14 @@ public:
    */
   friend bool operator != (const CharacterColor& a, const CharacterColor& b);
 
+  /** Writes the color space and value of @p color to @p stream, see Screen::saveState() */
+  friend QDataStream& operator << (QDataStream& stream, const CharacterColor& color);
+  /** Reads a color written by operator<<() from @p stream */
+  friend QDataStream& operator >> (QDataStream& stream, CharacterColor& color);
+
+  /** Returns a hash of the color space and value of @p color, see CellStyleTable */
+  friend size_t qHash(const CharacterColor& color, size_t seed);
+
 private:
   quint8 _colorSpace;
 
@@ -243,6 +255,19 @@ inline bool operator != (const CharacterColor& a, const CharacterColor& b)
     return !operator==(a,b);
 }
 
+inline QDataStream& operator << (QDataStream& stream, const CharacterColor& color)
+{
+    return stream << color._colorSpace << color._u << color._v << color._w;
+}
+inline QDataStream& operator >> (QDataStream& stream, CharacterColor& color)
+{
+    return stream >> color._colorSpace >> color._u >> color._v >> color._w;
+}
+inline size_t qHash(const CharacterColor& color, size_t seed = 0)
+{
+    return qHashMulti(seed, color._colorSpace, color._u, color._v, color._w);
+}
+
 inline const QColor color256(quint8 u, const ColorEntry* base)
 {
   //   0.. 16: system colors
@@ -32,6 +32,7 @@
 
 // Konsole
 #include "CharacterColor.h"
+#include "qtermwidget_core_export.h"
 
 class QIODevice;
 //class KConfig;
@@ -45,7 +46,7 @@ namespace Konsole
  * The color scheme includes the palette of colors used to draw the text and character backgrounds
  * in the display and the opacity level of the display background.
  */
-class ColorScheme
+class QTERMWIDGET_CORE_EXPORT ColorScheme
 {
 public:
     /**
@@ -213,7 +214,7 @@ private:
  * TODO Implement and make it the default on systems with specialized KDE
  * color schemes.
  */
-class AccessibleColorScheme : public ColorScheme
+class QTERMWIDGET_CORE_EXPORT AccessibleColorScheme : public ColorScheme
 {
 public:
     AccessibleColorScheme();
@@ -223,7 +224,7 @@ public:
  * Manages the color schemes available for use by terminal displays.
  * See ColorScheme
  */
-class ColorSchemeManager
+class QTERMWIDGET_CORE_EXPORT ColorSchemeManager
 {
 public:
 
@@ -0,0 +1,181 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef COMPACTCELL_H
+#define COMPACTCELL_H
+
+// Standard Library
+#include <cstring>
+
+// Qt
+#include <QHash>
+#include <QVector>
+
+// Konsole
+#include "Character.h"
+
+namespace Konsole
+{
+
+/**
+ * The colors and rendition of a Character, which are shared by many cells
+ * and therefore stored only once in a CellStyleTable.
+ */
+struct CellStyle
+{
+    CharacterColor foregroundColor;
+    CharacterColor backgroundColor;
+    quint16 rendition;
+};
+
+inline bool operator == (const CellStyle& a, const CellStyle& b)
+{
+    return a.rendition == b.rendition &&
+           a.foregroundColor == b.foregroundColor &&
+           a.backgroundColor == b.backgroundColor;
+}
+
+inline size_t qHash(const CellStyle& style, size_t seed = 0)
+{
+    return qHashMulti(seed, style.foregroundColor, style.backgroundColor, style.rendition);
+}
+
+/**
+ * A Character in half the space: the unicode character value (or extended
+ * character hash) and the id of its style in a CellStyleTable.
+ *
+ * Two cells of the same table look the same exactly if they are equal,
+ * which is a single 64-bit comparison.
+ */
+struct CompactCell
+{
+    quint32 character;
+    quint32 style;
+};
+
+static_assert(sizeof(CompactCell) == sizeof(quint64), "CompactCell must fit into 64 bits");
+
+inline bool operator == (const CompactCell& a, const CompactCell& b)
+{
+    quint64 x;
+    quint64 y;
+    memcpy(&x, &a, sizeof(x));
+    memcpy(&y, &b, sizeof(y));
+    return x == y;
+}
+
+inline bool operator != (const CompactCell& a, const CompactCell& b)
+{
+    return !operator==(a, b);
+}
+
+/**
+ * Interns the styles of characters, so that they can be stored as
+ * CompactCell.  Style 0 is the default style.
+ *
+ * Styles are never removed, so once size() grows too large, e.g. after a
+ * program drew true color gradients, the owner repacks the cells it keeps
+ * into a new table.
+ */
+class CellStyleTable
+{
+public:
+    CellStyleTable()
+    {
+        clear();
+    }
+
+    /** Removes all styles but the default style. */
+    void clear()
+    {
+        const Character defaultCharacter;
+        const CellStyle defaultStyle = { defaultCharacter.foregroundColor,
+                                         defaultCharacter.backgroundColor,
+                                         defaultCharacter.rendition };
+        _styles.clear();
+        _ids.clear();
+        _styles.append(defaultStyle);
+        _ids.insert(defaultStyle, 0);
+        _lastId = 0;
+    }
+
+    /** Returns the number of styles in the table. */
+    int size() const
+    {
+        return _styles.size();
+    }
+
+    /** Returns the id of the style of @p character, adding it if it is new. */
+    quint32 intern(const Character& character)
+    {
+        const CellStyle style = { character.foregroundColor,
+                                  character.backgroundColor,
+                                  character.rendition };
+        // runs of cells in the same style are far more common than changes
+        if (_styles.at(_lastId) == style)
+            return _lastId;
+
+        auto it = _ids.constFind(style);
+        if (it == _ids.constEnd())
+        {
+            it = _ids.insert(style, _styles.size());
+            _styles.append(style);
+        }
+        _lastId = it.value();
+        return _lastId;
+    }
+
+    /** Returns the style with the id @p id. */
+    const CellStyle& style(quint32 id) const
+    {
+        return _styles.at(id);
+    }
+
+    /** Packs @p character into a cell, adding its style if it is new. */
+    CompactCell pack(const Character& character)
+    {
+        return { static_cast<quint32>(character.character), intern(character) };
+    }
+
+    /** Packs @p count characters from @p source into @p dest. */
+    void pack(const Character* source, CompactCell* dest, int count)
+    {
+        for (int i = 0; i < count; i++)
+            dest[i] = pack(source[i]);
+    }
+
+    /** Returns the character a cell packed with this table stands for. */
+    Character unpack(const CompactCell& cell) const
+    {
+        const CellStyle& cellStyle = style(cell.style);
+        Character character(0, cellStyle.foregroundColor, cellStyle.backgroundColor,
+                            cellStyle.rendition);
+        character.character = cell.character;
+        return character;
+    }
+
+private:
+    QVector<CellStyle> _styles;
+    QHash<CellStyle, quint32> _ids;
+    quint32 _lastId;
+};
+
+}
+
+#endif // COMPACTCELL_H
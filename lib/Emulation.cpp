@@ -25,16 +25,21 @@
 // System
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <string>
 
 // Qt
-#include <QApplication>
-#include <QClipboard>
+#include <QDataStream>
+#include <QGuiApplication>
 #include <QHash>
 #include <QKeyEvent>
+#include <QMetaMethod>
 #include <QRegularExpression>
+#include <QScreen>
 #include <QTextStream>
 #include <QThread>
+#include <QtDebug>
 
 #include <QTime>
 
@@ -42,9 +47,8 @@
 #include "KeyboardTranslator.h"
 #include "Screen.h"
 #include "TerminalCharacterDecoder.h"
+#include "TerminalRecorder.h"
 #include "ScreenWindow.h"
-#include "Session.h"
-#include "TerminalDisplay.h"
 
 using namespace Konsole;
 
@@ -53,15 +57,32 @@ Emulation::Emulation() :
   _keyTranslator(nullptr),
   _usesMouse(false),
   _bracketedPasteMode(false),
-  _toUtf16(QStringConverter::Utf8)
+  _zmodemDetection(true),
+  _lastFrameTime(std::numeric_limits<int>::min()),
+  _frameInterval(16),
+  _updatePolicy(UpdatePolicy::LowLatency),
+  _suspendedWindows(0),
+  _updateDeferred(false),
+  _frameCache(std::make_unique<ScreenFrameCache>()),
+  _scrolledLinesTotal(0),
+  _droppedLinesTotal(0)
 {
   // create screens with a default size
   _screen[0] = new Screen(40,80);
   _screen[1] = new Screen(40,80);
   _currentScreen = _screen[0];
 
-  QObject::connect(&_bulkTimer1, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
-  QObject::connect(&_bulkTimer2, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
+  _frameTimer.setSingleShot(true);
+  _frameTimer.setTimerType(Qt::PreciseTimer);
+  QObject::connect(&_frameTimer, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
+  _frameClock.start();
+
+  _synchronizedUpdateTimer.setSingleShot(true);
+  QObject::connect(&_synchronizedUpdateTimer, &QTimer::timeout,
+                   this, &Konsole::Emulation::endSynchronizedUpdate);
+
+  if (qobject_cast<QGuiApplication*>(QCoreApplication::instance()) && QGuiApplication::primaryScreen())
+    setRefreshRate(QGuiApplication::primaryScreen()->refreshRate());
 
   // listen for mouse status changes
   connect(this, &Konsole::Emulation::programUsesMouseChanged,
@@ -95,15 +116,48 @@ void Emulation::bracketedPasteModeChanged(bool bracketedPasteMode)
     _bracketedPasteMode = bracketedPasteMode;
 }
 
+void Emulation::windowSuspendedChanged(bool suspended)
+{
+    if (suspended)
+    {
+        _suspendedWindows++;
+        return;
+    }
+
+    // bring the resumed window up to date right away, the output of
+    // the time it was suspended has not been shown anywhere
+    const bool wasSuspended = _suspendedWindows == _windows.size();
+    _suspendedWindows--;
+    if (wasSuspended)
+        showBulk();
+    else
+        bufferedUpdate();
+}
+
+bool Emulation::allWindowsSuspended() const
+{
+    return !_windows.isEmpty() && _suspendedWindows == _windows.size();
+}
+
 ScreenWindow* Emulation::createWindow()
 {
+    QMutexLocker locker(screenLock());
+
     ScreenWindow* window = new ScreenWindow();
     window->setScreen(_currentScreen);
+    window->setFrameCache(_frameCache.get());
+    if (_snapshots)
+        window->setSnapshotSource(_snapshots.get(), &_screenLock);
     _windows << window;
-    ExtendedCharTable::instance.windows << window;
+    {
+        QMutexLocker tableLocker(&ExtendedCharTable::instance.mutex);
+        ExtendedCharTable::instance.windows << window;
+    }
 
     connect(window, &Konsole::ScreenWindow::selectionChanged,
             this, &Konsole::Emulation::bufferedUpdate);
+    connect(window, &Konsole::ScreenWindow::suspendedChanged,
+            this, &Konsole::Emulation::windowSuspendedChanged);
 
     connect(this, &Konsole::Emulation::outputChanged,
             window, &Konsole::ScreenWindow::notifyOutputChanged);
@@ -118,11 +172,16 @@ ScreenWindow* Emulation::createWindow()
 
 Emulation::~Emulation()
 {
+  stopRecording();
+
   QListIterator<ScreenWindow*> windowIter(_windows);
   while (windowIter.hasNext())
   {
     auto win = windowIter.next();
-    ExtendedCharTable::instance.windows.remove(win);
+    {
+        QMutexLocker tableLocker(&ExtendedCharTable::instance.mutex);
+        ExtendedCharTable::instance.windows.remove(win);
+    }
     delete win;
   }
 
@@ -130,24 +189,96 @@ Emulation::~Emulation()
   delete _screen[1];
 }
 
+void Emulation::setThreaded(bool threaded)
+{
+  if (threaded == isThreaded())
+    return;
+
+  if (threaded)
+  {
+    _snapshots = std::make_unique<ScreenSnapshotBuffer>();
+    publishSnapshot();
+  }
+
+  // the serials of the frames change their meaning
+  _frameCache->clear();
+
+  for (ScreenWindow* window : std::as_const(_windows))
+    window->setSnapshotSource(_snapshots.get(), threaded ? &_screenLock : nullptr);
+
+  if (!threaded)
+    _snapshots.reset();
+}
+
+bool Emulation::isThreaded() const
+{
+  return _snapshots != nullptr;
+}
+
+QRecursiveMutex* Emulation::screenLock() const
+{
+  return _snapshots ? &_screenLock : nullptr;
+}
+
+void Emulation::publishSnapshot()
+{
+  QMutexLocker locker(&_screenLock);
+
+  ScreenSnapshot& snapshot = _snapshots->back();
+  const Screen* screen = _currentScreen;
+
+  snapshot.lines = screen->getLines();
+  snapshot.columns = screen->getColumns();
+  snapshot.histLines = screen->getHistLines();
+  snapshot.cursor = QPoint(screen->getCursorX(), screen->getCursorY());
+  snapshot.lastScrolledRegion = screen->lastScrolledRegion();
+
+  _scrolledLinesTotal += screen->scrolledLines();
+  _droppedLinesTotal += screen->droppedLines();
+  snapshot.scrolledLines = _scrolledLinesTotal;
+  snapshot.droppedLines = _droppedLinesTotal;
+  snapshot.dirtyLines = screen->dirtyLines();
+
+  const int firstLine = snapshot.histLines;
+  const int lastLine = snapshot.histLines + snapshot.lines - 1;
+  snapshot.image.resize(snapshot.lines * snapshot.columns);
+  screen->getImage(snapshot.image.data(), snapshot.image.size(), firstLine, lastLine);
+  snapshot.lineProperties = screen->getLineProperties(firstLine, lastLine);
+
+  _snapshots->publish();
+}
+
 void Emulation::setScreen(int n)
 {
   Screen *old = _currentScreen;
   _currentScreen = _screen[n & 1];
   if (_currentScreen != old)
   {
-     // tell all windows onto this emulation to switch to the newly active screen
+     // the other screen was not shown, so none of its lines are up to date
+     _currentScreen->setAllLinesDirty();
+
+     // tell all windows onto this emulation to switch to the newly active screen,
+     // in threaded mode they live in the thread of the views
+     Screen* screen = _currentScreen;
      for(ScreenWindow* window : std::as_const(_windows))
-         window->setScreen(_currentScreen);
+     {
+         if (window->thread() == QThread::currentThread())
+             window->setScreen(screen);
+         else
+             QMetaObject::invokeMethod(window, [window, screen] { window->setScreen(screen); },
+                                       Qt::QueuedConnection);
+     }
   }
 }
 
 void Emulation::clearHistory()
 {
+    QMutexLocker locker(screenLock());
     _screen[0]->setScroll( _screen[0]->getScroll() , false );
 }
 void Emulation::setHistory(const HistoryType& t)
 {
+  QMutexLocker locker(screenLock());
   _screen[0]->setScroll(t);
 
   showBulk();
@@ -158,6 +289,17 @@ const HistoryType& Emulation::history() const
   return _screen[0]->getScroll();
 }
 
+int Emulation::historySize() const
+{
+  QMutexLocker locker(screenLock());
+  const HistoryType& history = _screen[0]->getScroll();
+  if (!history.isEnabled())
+      return 0;
+  if (history.isUnlimited())
+      return -1;
+  return history.maximumLineCount();
+}
+
 void Emulation::setKeyBindings(const QString& name)
 {
   _keyTranslator = KeyboardTranslatorManager::instance()->findTranslator(name);
@@ -189,6 +331,12 @@ void Emulation::receiveChar(wchar_t c)
   };
 }
 
+void Emulation::receiveChars(const wchar_t* text, int length)
+{
+  for (int i = 0; i < length; i++)
+    receiveChar(text[i]);
+}
+
 void Emulation::sendKeyEvent(QKeyEvent* ev, bool)
 {
   emit stateSet(NOTIFYNORMAL);
@@ -218,36 +366,119 @@ TODO: Character composition from the old code.  See #96536
 
 void Emulation::receiveData(const char* text, int length)
 {
+    QMutexLocker locker(screenLock());
+
     emit stateSet(NOTIFYACTIVITY);
 
     bufferedUpdate();
 
-    /* XXX: the following code involves encoding & decoding of "UTF-16
-     * surrogate pairs", which does not work with characters higher than
-     * U+10FFFF
-     * https://unicodebook.readthedocs.io/unicode_encodings.html#surrogates
-     */
-    QByteArray ba(text, length);
-    QString str = _toUtf16(ba);
-    std::wstring unicodeText = str.toStdWString();
+    // decode straight from the caller's buffer, partial multi-byte
+    // sequences at the end of the block are completed by the next one
+    const size_t bufferLength = Utf8Decoder::maxOutputLength(length);
+    if (_decodeBuffer.size() < bufferLength)
+        _decodeBuffer.resize(bufferLength);
+    const int unicodeLength = _decoder.decode(text, length, _decodeBuffer.data());
 
     //send characters to terminal emulator
-    for (size_t i=0;i<unicodeText.length();i++)
-        receiveChar(unicodeText[i]);
+    receiveChars(_decodeBuffer.data(), unicodeLength);
+
+    if (_recorder)
+        _recorder->recordOutput(text, length);
 
     //look for z-modem indicator
-    //-- someone who understands more about z-modems that I do may be able to move
-    //this check into the above for loop?
-    for (int i=0;i<length;i++)
+    static const QMetaMethod zmodemDetectedSignal = QMetaMethod::fromSignal(&Emulation::zmodemDetected);
+    if (_zmodemDetection && isSignalConnected(zmodemDetectedSignal))
+        detectZModem(text, length);
+}
+
+void Emulation::saveState(QDataStream& stream) const
+{
+    QMutexLocker locker(screenLock());
+
+    stream << quint8(_currentScreen == _screen[1] ? 1 : 0);
+    _screen[0]->saveState(stream);
+    _screen[1]->saveState(stream);
+}
+
+bool Emulation::restoreState(QDataStream& stream)
+{
+    QMutexLocker locker(screenLock());
+
+    const QSize oldSize = imageSize();
+    quint8 screen = 0;
+    stream >> screen;
+    if (!_screen[0]->restoreState(stream) || !_screen[1]->restoreState(stream))
+        return false;
+
+    _decoder.reset();
+    setScreen(screen);
+
+    const QSize newSize = imageSize();
+    if (newSize != oldSize)
+        emit imageSizeChanged(newSize.height(), newSize.width());
+
+    bufferedUpdate();
+    return true;
+}
+
+bool Emulation::hasPendingSequence() const
+{
+    return _decoder.hasPendingSequence();
+}
+
+bool Emulation::startRecording(QIODevice* device, int keyframeInterval)
+{
+    QMutexLocker locker(screenLock());
+
+    stopRecording();
+
+    auto recorder = std::make_unique<TerminalRecorder>(this, device, keyframeInterval);
+    if (!recorder->start())
+        return false;
+    _recorder = std::move(recorder);
+    return true;
+}
+
+void Emulation::stopRecording()
+{
+    QMutexLocker locker(screenLock());
+
+    if (_recorder)
     {
-        if (text[i] == '\030')
-        {
-            if ((length-i-1 > 3) && (strncmp(text+i+1, "B00", 3) == 0))
-                emit zmodemDetected();
-        }
+        _recorder->finish();
+        _recorder.reset();
+    }
+}
+
+bool Emulation::isRecording() const
+{
+    return _recorder != nullptr;
+}
+
+void Emulation::detectZModem(const char* text, int length)
+{
+    // memchr() skips ahead to the next CAN (0x18) much faster than a
+    // byte by byte loop, and CAN hardly ever occurs in regular output
+    const char* end = text + length;
+    const char* p = static_cast<const char*>(memchr(text, '\030', length));
+    while (p)
+    {
+        if ((end-p-1 > 3) && (memcmp(p+1, "B00", 3) == 0))
+            emit zmodemDetected();
+        p = static_cast<const char*>(memchr(p + 1, '\030', end - p - 1));
     }
 }
 
+void Emulation::setZModemDetectionEnabled(bool enabled)
+{
+    _zmodemDetection = enabled;
+}
+
+bool Emulation::zmodemDetectionEnabled() const
+{
+    return _zmodemDetection;
+}
+
 //OLDER VERSION
 //This version of onRcvBlock was commented out because
 //    a)  It decoded incoming characters one-by-one, which is slow in the current version of Qt (4.2 tech preview)
@@ -301,38 +532,122 @@ void Emulation::writeToStream( TerminalCharacterDecoder* _decoder ,
                                int startLine ,
                                int endLine)
 {
+  QMutexLocker locker(screenLock());
   _currentScreen->writeLinesToStream(_decoder,startLine,endLine);
 }
 
 int Emulation::lineCount() const
 {
+    QMutexLocker locker(screenLock());
     // sum number of lines currently on _screen plus number of lines in history
     return _currentScreen->getLines() + _currentScreen->getHistLines();
 }
 
 void Emulation::showBulk()
 {
-    _bulkTimer1.stop();
-    _bulkTimer2.stop();
+    _frameTimer.stop();
+
+    // the update was scheduled before a synchronized update started
+    if (_synchronizedUpdateTimer.isActive())
+    {
+        _updateDeferred = true;
+        return;
+    }
+
+    // the counts of scrolled and dropped lines keep adding up until the
+    // next update, so the windows can catch up with them once resumed
+    if (allWindowsSuspended())
+        return;
+
+    _lastFrameTime = _frameClock.elapsed();
+
+    QMutexLocker locker(screenLock());
+
+    // windows of a threaded emulation pick up the snapshot when they
+    // receive outputChanged() on their own thread
+    if (_snapshots)
+        publishSnapshot();
+    else
+        _frameCache->advance();
 
     emit outputChanged();
 
     _currentScreen->resetScrolledLines();
     _currentScreen->resetDroppedLines();
+    _currentScreen->resetDirtyLines();
 }
 
 void Emulation::bufferedUpdate()
 {
-    static const int BULK_TIMEOUT1 = 10;
-    static const int BULK_TIMEOUT2 = 40;
+    if (_synchronizedUpdateTimer.isActive())
+    {
+        _updateDeferred = true;
+        return;
+    }
+    if (_frameTimer.isActive() || allWindowsSuspended())
+        return;
+
+    // Output after a quiet period, such as the echo of a keystroke, is
+    // shown on the next pass of the event loop.  While output keeps
+    // coming the updates are spaced a refresh interval apart, or two
+    // with the throughput policy, which first collects a whole interval.
+    const qint64 sinceLastFrame = _frameClock.elapsed() - _lastFrameTime;
+    qint64 delay;
+    if (_updatePolicy == UpdatePolicy::LowLatency)
+        delay = _frameInterval - sinceLastFrame;
+    else if (sinceLastFrame >= 2 * _frameInterval)
+        delay = _frameInterval;
+    else
+        delay = 2 * _frameInterval - sinceLastFrame;
+
+    _frameTimer.start(int(qBound<qint64>(0, delay, 2 * _frameInterval)));
+}
+
+void Emulation::beginSynchronizedUpdate()
+{
+    // programs which crash or are killed halfway through a frame must not
+    // freeze the views, so the update ends on its own after a while
+    static const int SYNCHRONIZED_UPDATE_TIMEOUT = 200;
+
+    _synchronizedUpdateTimer.start(SYNCHRONIZED_UPDATE_TIMEOUT);
+}
+
+void Emulation::endSynchronizedUpdate()
+{
+    _synchronizedUpdateTimer.stop();
+    if (_updateDeferred)
+    {
+        _updateDeferred = false;
+        bufferedUpdate();
+    }
+}
+
+void Emulation::setUpdatePolicy(UpdatePolicy policy)
+{
+    QMutexLocker locker(screenLock());
+    _updatePolicy = policy;
+}
+
+Emulation::UpdatePolicy Emulation::updatePolicy() const
+{
+    QMutexLocker locker(screenLock());
+    return _updatePolicy;
+}
+
+void Emulation::setRefreshRate(qreal rate)
+{
+    if (rate <= 0)
+        return;
+
+    QMutexLocker locker(screenLock());
+    // below 10 Hz updates would lag noticeably behind the output
+    _frameInterval = qBound(1, qRound(1000 / rate), 100);
+}
 
-   _bulkTimer1.setSingleShot(true);
-   _bulkTimer1.start(BULK_TIMEOUT1);
-   if (!_bulkTimer2.isActive())
-   {
-      _bulkTimer2.setSingleShot(true);
-      _bulkTimer2.start(BULK_TIMEOUT2);
-   }
+qreal Emulation::refreshRate() const
+{
+    QMutexLocker locker(screenLock());
+    return 1000.0 / _frameInterval;
 }
 
 char Emulation::eraseChar() const
@@ -345,6 +660,8 @@ void Emulation::setImageSize(int lines, int columns)
   if ((lines < 1) || (columns < 1))
     return;
 
+  QMutexLocker locker(screenLock());
+
   QSize screenSize[2] = { QSize(_screen[0]->getColumns(),
                                 _screen[0]->getLines()),
                           QSize(_screen[1]->getColumns(),
@@ -357,6 +674,9 @@ void Emulation::setImageSize(int lines, int columns)
   _screen[0]->resizeImage(lines,columns);
   _screen[1]->resizeImage(lines,columns);
 
+  if (_recorder)
+    _recorder->recordResize(lines, columns);
+
   emit imageSizeChanged(lines,columns);
 
   bufferedUpdate();
@@ -364,6 +684,7 @@ void Emulation::setImageSize(int lines, int columns)
 
 QSize Emulation::imageSize() const
 {
+  QMutexLocker locker(screenLock());
   return {_currentScreen->getColumns(), _currentScreen->getLines()};
 }
 
@@ -395,6 +716,8 @@ bool ExtendedCharTable::extendedCharMatch(uint hash , uint* unicodePoints , usho
 }
 uint ExtendedCharTable::createExtendedChar(uint* unicodePoints , ushort length)
 {
+    QMutexLocker locker(&mutex);
+
     // look for this sequence of points in the table
     uint hash = extendedCharHash(unicodePoints,length);
     const uint initialHash = hash;
@@ -470,8 +793,11 @@ uint ExtendedCharTable::createExtendedChar(uint* unicodePoints , ushort length)
 uint* ExtendedCharTable::lookupExtendedChar(uint hash , ushort& length) const
 {
     // lookup index in table and if found, set the length
-    // argument and return a pointer to the character sequence
+    // argument and return a pointer to the character sequence.
+    // entries are never freed while the table exists, so the pointer
+    // stays valid after the lock is released
 
+    QMutexLocker locker(&mutex);
     uint* buffer = extendedCharTable[hash];
     if ( buffer )
     {
@@ -27,22 +27,34 @@
 #include <cstdio>
 
 // Qt
+#include <QElapsedTimer>
 #include <QKeyEvent>
 //#include <QPointer>
+#include <QRecursiveMutex>
 #include <QTextStream>
 #include <QTimer>
-#include <QStringDecoder>
 
-#include "qtermwidget_export.h"
+class QDataStream;
+class QIODevice;
+
+// Standard Library
+#include <memory>
+#include <vector>
+
+#include "qtermwidget_core_export.h"
 #include "KeyboardTranslator.h"
+#include "Utf8Decoder.h"
 
 namespace Konsole
 {
 
 class HistoryType;
 class Screen;
+class ScreenFrameCache;
+class ScreenSnapshotBuffer;
 class ScreenWindow;
 class TerminalCharacterDecoder;
+class TerminalRecorder;
 
 /**
  * This enum describes the available states which
@@ -118,7 +130,7 @@ enum
  * how long the emulation has been active/idle for and also respond to
  * a 'bell' event in different ways.
  */
-class QTERMWIDGET_EXPORT Emulation : public QObject
+class QTERMWIDGET_CORE_EXPORT Emulation : public QObject
 {
 Q_OBJECT
 
@@ -143,6 +155,25 @@ public:
       IBeamCursor = 2
   };
 
+  /**
+   * This enum describes how the emulation schedules the updates of its
+   * views after receiving output.  See setUpdatePolicy()
+   */
+  enum class UpdatePolicy {
+      /**
+       * Output which arrives after a quiet period is shown right away, so
+       * that echoed keystrokes appear without delay.  Continuous output is
+       * shown once per refresh of the screen.
+       */
+      LowLatency = 0,
+      /**
+       * Output is collected for a whole refresh interval before it is
+       * shown, and continuous output is shown at half the refresh rate,
+       * which leaves more time for processing it.
+       */
+      HighThroughput = 1
+  };
+
 
    /** Constructs a new terminal emulation */
    Emulation();
@@ -155,6 +186,25 @@ public:
    */
   ScreenWindow* createWindow();
 
+  /**
+   * Prepares the emulation for running on a thread other than the one of
+   * its windows, or for returning to it.  While threaded, the emulation
+   * publishes a snapshot of the screen at the end of each update which
+   * its windows display, and holds screenLock() while it changes the
+   * screens.  Moving the emulation to the thread is up to the caller,
+   * see Session::setThreadedEmulation()
+   */
+  void setThreaded(bool threaded);
+  /** Returns whether the emulation is prepared to run on a worker thread */
+  bool isThreaded() const;
+
+  /**
+   * Returns the lock which has to be held while the screens are accessed
+   * from another thread than the emulation's, or nullptr if the emulation
+   * is not threaded.
+   */
+  QRecursiveMutex* screenLock() const;
+
   /** Returns the size of the screen image which the emulation produces */
   QSize imageSize() const;
 
@@ -174,6 +224,12 @@ public:
   void setHistory(const HistoryType&);
   /** Returns the history store used by this emulation.  See setHistory() */
   const HistoryType& history() const;
+  /**
+   * Returns the number of lines the history keeps: 0 if it is disabled
+   * and -1 if it is unlimited.  Unlike history() this may be called from
+   * any thread.
+   */
+  int historySize() const;
   /** Clears the history scroll. */
   void clearHistory();
 
@@ -224,6 +280,72 @@ public:
 
   bool programBracketedPasteMode() const;
 
+  /**
+   * Sets whether incoming data is searched for the start of a ZModem
+   * transfer, see zmodemDetected().  Enabled by default; embedders which
+   * never offer ZModem transfers can disable it to skip the search.
+   * The search is also skipped while zmodemDetected() is not connected.
+   */
+  void setZModemDetectionEnabled(bool enabled);
+  bool zmodemDetectionEnabled() const;
+
+  /**
+   * Sets how updates of the views are scheduled after output is received.
+   * Defaults to UpdatePolicy::LowLatency.
+   */
+  void setUpdatePolicy(UpdatePolicy policy);
+  /** Returns how updates of the views are scheduled.  See setUpdatePolicy() */
+  UpdatePolicy updatePolicy() const;
+
+  /**
+   * Sets the refresh rate in Hz of the screen the views are shown on.
+   * The views are not updated more often than this.  Defaults to the
+   * refresh rate of the primary screen, or 60 Hz without one.
+   */
+  void setRefreshRate(qreal rate);
+  /** Returns the refresh rate the updates are aligned to.  See setRefreshRate() */
+  qreal refreshRate() const;
+
+  /**
+   * Writes the state of the screens to @p stream, so that restoreState()
+   * can bring an emulation back to it.  This covers the images, cursors,
+   * renditions, modes and tab stops but not the history.
+   *
+   * The state should be saved while hasPendingSequence() is false, data
+   * following it is otherwise not understood after a restore.
+   */
+  virtual void saveState(QDataStream& stream) const;
+  /**
+   * Restores a state written by saveState() and discards any partially
+   * received sequence.  Returns false if @p stream does not hold a valid
+   * state.
+   */
+  virtual bool restoreState(QDataStream& stream);
+  /**
+   * Returns true if the data received so far ends within an escape
+   * sequence or a multi-byte character.
+   */
+  virtual bool hasPendingSequence() const;
+
+  /**
+   * Starts recording the data received by the emulation and the changes
+   * of its size to @p device, together with the time they happened at,
+   * so that they can be played back with TerminalReplayer.
+   *
+   * A keyframe with the state of the screens is written at the start and
+   * again every @p keyframeInterval milliseconds while output arrives,
+   * which lets the replayer seek without playing back everything before.
+   *
+   * @p device must be open for writing and seekable, and stay valid until
+   * stopRecording().  It is written from the thread of the emulation.
+   * Returns false if the recording could not be started.
+   */
+  bool startRecording(QIODevice* device, int keyframeInterval = 5000);
+  /** Finishes the recording started by startRecording(). */
+  void stopRecording();
+  /** Returns whether the emulation is being recorded. */
+  bool isRecording() const;
+
 public slots:
 
   /** Change the size of the emulation's image */
@@ -258,8 +380,8 @@ public slots:
 
   /**
    * Processes an incoming stream of characters.  receiveData() decodes the incoming
-   * character buffer using the current codec(), and then calls receiveChar() for
-   * each unicode character in the resulting buffer.
+   * character buffer using the current codec(), and then passes the resulting
+   * unicode characters to receiveChars().
    *
    * receiveData() also starts a timer which causes the outputChanged() signal
    * to be emitted when it expires.  The timer allows multiple updates in quick
@@ -308,7 +430,10 @@ signals:
    */
   void stateSet(int state);
 
-  /** TODO Document me */
+  /**
+   * Emitted when the start of a ZModem transfer, CAN (0x18) followed by "B00", is seen in
+   * the incoming data.  See setZModemDetectionEnabled()
+   */
   void zmodemDetected();
 
 
@@ -441,6 +566,14 @@ protected:
    */
   virtual void receiveChar(wchar_t ch);
 
+  /**
+   * Processes a block of incoming characters.  See receiveData()
+   *
+   * The default implementation calls receiveChar() for each character,
+   * emulations may reimplement it to handle runs of characters at once.
+   */
+  virtual void receiveChars(const wchar_t* text, int length);
+
   /**
    * Sets the active screen.  The terminal has two screens, primary and alternate.
    * The primary screen is used by default.  When certain interactive programs such
@@ -457,6 +590,16 @@ protected:
   };
   void setCodec(EmulationCodec codec); // codec number, 0 = locale, 1=utf8
 
+  /**
+   * Starts a synchronized update, during which the views are not updated
+   * so that they never show a partially drawn frame.  The update ends with
+   * endSynchronizedUpdate(), or after a timeout in case the program never
+   * ends it.
+   */
+  void beginSynchronizedUpdate();
+  /** Ends a synchronized update and shows the result.  See beginSynchronizedUpdate() */
+  void endSynchronizedUpdate();
+
 
   QList<ScreenWindow*> _windows;
 
@@ -475,26 +618,59 @@ protected slots:
   /**
    * Schedules an update of attached views.
    * Repeated calls to bufferedUpdate() in close succession will result in only a single update,
-   * much like the Qt buffered update of widgets.
+   * much like the Qt buffered update of widgets.  Updates are aligned to the refresh rate of
+   * the screen, see setUpdatePolicy() and setRefreshRate().
    */
   void bufferedUpdate();
 
 private slots:
 
-  // triggered by timer, causes the emulation to send an updated screen image to each
-  // view
+  // triggered by the frame timer, causes the emulation to send an updated
+  // screen image to each view
   void showBulk();
 
   void usesMouseChanged(bool usesMouse);
 
   void bracketedPasteModeChanged(bool bracketedPasteMode);
 
+  // counts the suspended windows, see ScreenWindow::setSuspended()
+  void windowSuspendedChanged(bool suspended);
+
 private:
+  // returns true if there are windows and all of them are suspended
+  bool allWindowsSuspended() const;
+
+  // emits zmodemDetected() for each ZModem header start in text
+  void detectZModem(const char* text, int length);
+  // copies the current screen into _snapshots and publishes it
+  void publishSnapshot();
+
   bool _usesMouse;
   bool _bracketedPasteMode;
-  QTimer _bulkTimer1{this};
-  QTimer _bulkTimer2{this};
-  QStringDecoder _toUtf16;
+  bool _zmodemDetection;
+  // see bufferedUpdate()
+  QTimer _frameTimer{this};
+  QElapsedTimer _frameClock;
+  qint64 _lastFrameTime;
+  int _frameInterval;
+  UpdatePolicy _updatePolicy;
+  int _suspendedWindows;
+  // see beginSynchronizedUpdate()
+  QTimer _synchronizedUpdateTimer{this};
+  bool _updateDeferred;
+  Utf8Decoder _decoder;
+  std::vector<wchar_t> _decodeBuffer;
+
+  // see setThreaded()
+  mutable QRecursiveMutex _screenLock;
+  std::unique_ptr<ScreenSnapshotBuffer> _snapshots;
+  // lets windows showing the same lines share their frames
+  std::unique_ptr<ScreenFrameCache> _frameCache;
+  qint64 _scrolledLinesTotal;
+  qint64 _droppedLinesTotal;
+
+  // see startRecording()
+  std::unique_ptr<TerminalRecorder> _recorder;
 };
 
 }
@@ -25,7 +25,7 @@
 
 // Qt
 #include <QAction>
-#include <QApplication>
+#include <QGuiApplication>
 #include <QtAlgorithms>
 #include <QClipboard>
 #include <QString>
@@ -440,7 +440,7 @@ void UrlFilter::HotSpot::activate(const QString& actionName)
 
     if ( actionName == QLatin1String("copy-action") )
     {
-        QApplication::clipboard()->setText(url);
+        QGuiApplication::clipboard()->setText(url);
         return;
     }
 
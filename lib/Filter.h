@@ -29,7 +29,7 @@
 #include <QRegularExpression>
 
 // Local
-#include "qtermwidget_export.h"
+#include "qtermwidget_core_export.h"
 
 namespace Konsole
 {
@@ -55,7 +55,7 @@ class Character;
  * When processing the text they should create instances of Filter::HotSpot subclasses for sections of interest
  * and add them to the filter's list of hotspots using addHotSpot()
  */
-class QTERMWIDGET_EXPORT Filter : public QObject
+class QTERMWIDGET_CORE_EXPORT Filter : public QObject
 {
 public:
     /**
@@ -184,7 +184,7 @@ private:
  * Subclasses can reimplement newHotSpot() to return custom hotspot types when matches for the regular expression
  * are found.
  */
-class QTERMWIDGET_EXPORT RegExpFilter : public Filter
+class QTERMWIDGET_CORE_EXPORT RegExpFilter : public Filter
 {
 public:
     /**
@@ -241,7 +241,7 @@ private:
 class FilterObject;
 
 /** A filter which matches URLs in blocks of text */
-class QTERMWIDGET_EXPORT UrlFilter : public RegExpFilter
+class QTERMWIDGET_CORE_EXPORT UrlFilter : public RegExpFilter
 {
     Q_OBJECT
 public:
@@ -296,7 +296,7 @@ signals:
     void activated(const QUrl& url, bool fromContextMenu);
 };
 
-class QTERMWIDGET_NO_EXPORT FilterObject : public QObject
+class QTERMWIDGET_CORE_NO_EXPORT FilterObject : public QObject
 {
     Q_OBJECT
 public:
@@ -328,7 +328,7 @@ signals:
  * The hotSpots() and hotSpotsAtLine() method return all of the hotspots in the text and on
  * a given line respectively.
  */
-class QTERMWIDGET_EXPORT FilterChain : protected QList<Filter*>
+class QTERMWIDGET_CORE_EXPORT FilterChain : protected QList<Filter*>
 {
 public:
     virtual ~FilterChain();
@@ -362,7 +362,7 @@ public:
 };
 
 /** A filter chain which processes character images from terminal displays */
-class QTERMWIDGET_NO_EXPORT TerminalImageFilterChain : public FilterChain
+class QTERMWIDGET_CORE_EXPORT TerminalImageFilterChain : public FilterChain
 {
 public:
     TerminalImageFilterChain();
@@ -0,0 +1,327 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "HeadlessSession.h"
+
+// System
+#ifndef Q_OS_WIN
+#include <csignal>
+#endif
+
+// Qt
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QtDebug>
+
+// Konsole
+#include "History.h"
+#include "Pty.h"
+#include "ScreenWindow.h"
+#include "ShellCommand.h"
+#include "TerminalCharacterDecoder.h"
+#include "Vt102Emulation.h"
+
+using namespace Konsole;
+
+HeadlessSession::HeadlessSession(QObject* parent) :
+    QObject(parent),
+    _emulation(nullptr),
+    _window(nullptr),
+    _shellProcess(nullptr),
+    _historyCompressed(false)
+{
+    _emulation = new Vt102Emulation();
+    _emulation->setParent(this);
+    _emulation->setKeyBindings(QString());
+
+    // the window is only used to follow the cursor, there is no view
+    _window = _emulation->createWindow();
+    _window->setTrackOutput(true);
+
+    connect(_emulation, &Emulation::outputChanged, this, &HeadlessSession::outputChanged);
+    connect(_emulation, &Emulation::titleChanged, this, &HeadlessSession::onTitleChanged);
+    connect(_emulation, &Emulation::stateSet, this, &HeadlessSession::onStateSet);
+}
+
+HeadlessSession::~HeadlessSession()
+{
+    if (_shellProcess) {
+        disconnect(_shellProcess, nullptr, this, nullptr);
+        if (isRunning())
+            close();
+    }
+}
+
+Emulation* HeadlessSession::emulation() const
+{
+    return _emulation;
+}
+
+void HeadlessSession::setSize(int lines, int columns)
+{
+    if (lines < 1 || columns < 1)
+        return;
+
+    _emulation->setImageSize(lines, columns);
+    if (_shellProcess)
+        _shellProcess->setWindowSize(lines, columns);
+}
+
+QSize HeadlessSession::size() const
+{
+    return _emulation->imageSize();
+}
+
+void HeadlessSession::setHistorySize(int lines)
+{
+    if (_historyCompressed && lines != 0)
+        _emulation->setHistory(CompressedHistoryType(lines > 0 ? lines : 0));
+    else if (lines < 0)
+        _emulation->setHistory(HistoryTypeFile());
+    else if (lines == 0)
+        _emulation->setHistory(HistoryTypeNone());
+    else
+        _emulation->setHistory(HistoryTypeBuffer(lines));
+}
+
+int HeadlessSession::historySize() const
+{
+    return _emulation->historySize();
+}
+
+void HeadlessSession::setHistoryCompressed(bool compressed)
+{
+    if (_historyCompressed == compressed)
+        return;
+
+    _historyCompressed = compressed;
+    const int lines = historySize();
+    if (lines != 0)
+        setHistorySize(lines);
+}
+
+bool HeadlessSession::historyCompressed() const
+{
+    return _historyCompressed;
+}
+
+void HeadlessSession::setKeyBindings(const QString& name)
+{
+    _emulation->setKeyBindings(name);
+}
+
+void HeadlessSession::setProgram(const QString& program)
+{
+    _program = ShellCommand::expand(program);
+}
+
+void HeadlessSession::setArguments(const QStringList& arguments)
+{
+    _arguments = ShellCommand::expand(arguments);
+}
+
+void HeadlessSession::setWorkingDirectory(const QString& dir)
+{
+    _workingDirectory = ShellCommand::expand(dir);
+}
+
+void HeadlessSession::setEnvironment(const QStringList& environment)
+{
+    _environment = environment;
+}
+
+bool HeadlessSession::start()
+{
+    if (isRunning())
+        return false;
+
+    QString exec = _program;
+    if (exec.isEmpty())
+        exec = QString::fromLocal8Bit(qgetenv("SHELL"));
+#ifndef Q_OS_WIN
+    if (exec.isEmpty() || (exec.startsWith(QLatin1Char('/')) && !QFile::exists(exec)))
+        exec = QStringLiteral("/bin/sh");
+#else
+    if (exec.isEmpty())
+        exec = QStringLiteral("C:\\WINDOWS\\system32\\cmd.exe");
+#endif
+
+    const QString workingDirectory = _workingDirectory.isEmpty() ? QDir::currentPath()
+                                                                 : _workingDirectory;
+    const QSize screenSize = _emulation->imageSize();
+
+    delete _shellProcess;
+    _shellProcess = new Pty(this);
+    _shellProcess->setUtf8Mode(true);
+    _shellProcess->setErase(_emulation->eraseChar());
+
+    connect(_shellProcess, SIGNAL(receivedData(const char *,int)),
+            this, SLOT(onReceiveBlock(const char *,int)));
+    connect(_emulation, &Emulation::sendData, this, &HeadlessSession::onSendData,
+            Qt::UniqueConnection);
+    connect(_emulation, SIGNAL(lockPtyRequest(bool)), _shellProcess, SLOT(lockPty(bool)));
+    connect(_emulation, SIGNAL(useUtf8Request(bool)), _shellProcess, SLOT(setUtf8Mode(bool)));
+    connect(_shellProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SIGNAL(finished(int,QProcess::ExitStatus)));
+
+#ifndef Q_OS_WIN
+    _shellProcess->setWorkingDirectory(workingDirectory);
+    _shellProcess->setWindowSize(screenSize.height(), screenSize.width());
+
+    // the first argument is the name of the program, see Pty::start()
+    const int result = _shellProcess->start(exec, QStringList(exec) << _arguments,
+                                            _environment, 0, false);
+#else
+    const int result = _shellProcess->start(exec, QStringList(exec) << _arguments,
+                                            workingDirectory, _environment,
+                                            screenSize.width(), screenSize.height());
+#endif
+
+    if (result < 0) {
+        qWarning() << "Could not start" << exec;
+        return false;
+    }
+
+    _shellProcess->setWriteable(false);
+    emit started();
+    return true;
+}
+
+bool HeadlessSession::isRunning() const
+{
+#ifdef Q_OS_WIN
+    return _shellProcess && _shellProcess->isRunning();
+#else
+    return _shellProcess && _shellProcess->state() == QProcess::Running;
+#endif
+}
+
+int HeadlessSession::processId() const
+{
+    return isRunning() ? static_cast<int>(_shellProcess->processId()) : 0;
+}
+
+void HeadlessSession::close()
+{
+    if (!isRunning())
+        return;
+
+#ifdef Q_OS_WIN
+    _shellProcess->kill();
+#else
+    const pid_t pid = static_cast<pid_t>(_shellProcess->processId());
+    if (::kill(pid, SIGHUP) != 0 && ::kill(pid, SIGKILL) != 0)
+        qWarning() << "Process" << pid << "could not be killed";
+#endif
+}
+
+void HeadlessSession::receiveData(const char* data, int length)
+{
+    _emulation->receiveData(data, length);
+}
+
+void HeadlessSession::receiveData(const QByteArray& data)
+{
+    _emulation->receiveData(data.constData(), data.size());
+}
+
+void HeadlessSession::sendText(const QString& text)
+{
+    _emulation->sendText(text);
+}
+
+void HeadlessSession::sendData(const QByteArray& data)
+{
+    if (_shellProcess)
+        _shellProcess->sendData(data.constData(), data.size());
+}
+
+QString HeadlessSession::title() const
+{
+    return _title;
+}
+
+int HeadlessSession::historyLinesCount() const
+{
+    return _emulation->lineCount() - _emulation->imageSize().height();
+}
+
+QPoint HeadlessSession::cursorPosition() const
+{
+    return _window->cursorPosition();
+}
+
+QString HeadlessSession::text(int startLine, int endLine) const
+{
+    QString result;
+    QTextStream stream(&result);
+    PlainTextDecoder decoder;
+    decoder.setTrailingWhitespace(false);
+    decoder.begin(&stream);
+    _emulation->writeToStream(&decoder, qMax(0, startLine),
+                              endLine < 0 ? _emulation->lineCount() - 1 : endLine);
+    decoder.end();
+    return result;
+}
+
+QString HeadlessSession::screenText() const
+{
+    return text(historyLinesCount());
+}
+
+QString HeadlessSession::html(int startLine, int endLine) const
+{
+    QString result;
+    QTextStream stream(&result);
+    HTMLDecoder decoder;
+    decoder.begin(&stream);
+    _emulation->writeToStream(&decoder, qMax(0, startLine),
+                              endLine < 0 ? _emulation->lineCount() - 1 : endLine);
+    decoder.end();
+    return result;
+}
+
+void HeadlessSession::onTitleChanged(int what, const QString& caption)
+{
+    // 0 sets the title and the icon name, 2 only the title
+    if ((what != 0 && what != 2) || caption == _title)
+        return;
+
+    _title = caption;
+    emit titleChanged(_title);
+}
+
+void HeadlessSession::onStateSet(int state)
+{
+    if (state == NOTIFYBELL)
+        emit bell();
+}
+
+void HeadlessSession::onSendData(const char* data, int length)
+{
+    if (_shellProcess)
+        _shellProcess->sendData(data, length);
+}
+
+void HeadlessSession::onReceiveBlock(const char* data, int length)
+{
+    _emulation->receiveData(data, length);
+}
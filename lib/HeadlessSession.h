@@ -0,0 +1,175 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef HEADLESSSESSION_H
+#define HEADLESSSESSION_H
+
+// Qt
+#include <QObject>
+#include <QPoint>
+#include <QProcess>
+#include <QSize>
+#include <QStringList>
+
+#include "qtermwidget_core_export.h"
+
+namespace Konsole
+{
+
+class Emulation;
+class Pty;
+class ScreenWindow;
+
+/**
+ * A terminal session without any view, provided by the core library.
+ *
+ * It owns an emulation and, once start() is called, a pseudo-teletype
+ * running a program.  Output can also be fed in directly with
+ * receiveData(), which is all that is needed to render logs or recorded
+ * terminal output.  The contents of the screen and the history are read
+ * back as plain text or HTML.
+ *
+ * Only QtCore and QtGui are used, so many sessions can be run by a
+ * QCoreApplication, e.g. on a server or in test automation.
+ */
+class QTERMWIDGET_CORE_EXPORT HeadlessSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HeadlessSession(QObject* parent = nullptr);
+    ~HeadlessSession() override;
+
+    /** Returns the emulation of this session. */
+    Emulation* emulation() const;
+
+    /**
+     * Sets the size of the screen in lines and columns.  If a program is
+     * running, its terminal is resized as well.
+     */
+    void setSize(int lines, int columns);
+    /** Returns the size of the screen, in columns (width) and lines (height). */
+    QSize size() const;
+
+    /**
+     * Sets the number of lines kept in the history.  0 disables the
+     * history and a negative value makes it unlimited.
+     */
+    void setHistorySize(int lines);
+    int historySize() const;
+
+    /**
+     * Sets whether the history compresses older lines in memory, see
+     * CompressedHistoryType.  Takes effect immediately and for later calls
+     * to setHistorySize().  Disabled by default.
+     */
+    void setHistoryCompressed(bool compressed);
+    bool historyCompressed() const;
+
+    /** Sets the key bindings used by sendText(), see KeyboardTranslatorManager. */
+    void setKeyBindings(const QString& name);
+
+    /** Sets the program started by start() and the arguments passed to it. */
+    void setProgram(const QString& program);
+    void setArguments(const QStringList& arguments);
+    void setWorkingDirectory(const QString& dir);
+    /** Sets key=value pairs added to the environment of the program. */
+    void setEnvironment(const QStringList& environment);
+
+    /**
+     * Starts the program in a new pseudo-teletype.  If no program was set,
+     * $SHELL or /bin/sh is started.  Returns false if it could not be
+     * started.
+     */
+    bool start();
+    /** Returns true while the program started by start() is running. */
+    bool isRunning() const;
+    /** Returns the process id of the program, or 0 if it is not running. */
+    int processId() const;
+    /** Sends SIGHUP to the program, or kills it if that fails. */
+    void close();
+
+    /**
+     * Feeds output to the emulation as if the program had written it.
+     * This works whether or not a program is running.
+     */
+    void receiveData(const char* data, int length);
+    void receiveData(const QByteArray& data);
+
+    /** Types @p text into the program, using the current key bindings. */
+    void sendText(const QString& text);
+    /** Writes @p data unchanged to the program. */
+    void sendData(const QByteArray& data);
+
+    /** Returns the title set by the program with the xterm title sequences. */
+    QString title() const;
+
+    /** Returns the number of lines in the history. */
+    int historyLinesCount() const;
+    /** Returns the position of the cursor on the screen, in columns and lines. */
+    QPoint cursorPosition() const;
+
+    /**
+     * Returns the lines @p startLine to @p endLine as plain text.  Line 0
+     * is the oldest line of the history and lines after the history are
+     * the lines of the screen.  A negative @p endLine means the last line.
+     */
+    QString text(int startLine = 0, int endLine = -1) const;
+    /** Returns the lines on the screen as plain text. */
+    QString screenText() const;
+    /** Like text(), but keeps the colors and attributes as HTML markup. */
+    QString html(int startLine = 0, int endLine = -1) const;
+
+signals:
+    /**
+     * Emitted after the screen has changed.  Changes are batched in the
+     * same way as for a TerminalDisplay, so this needs an event loop.
+     */
+    void outputChanged();
+    /** Emitted when the program changes the title. */
+    void titleChanged(const QString& title);
+    /** Emitted when the program rings the bell. */
+    void bell();
+    /** Emitted once the program has been started. */
+    void started();
+    /** Emitted when the program has exited. */
+    void finished(int exitCode, QProcess::ExitStatus exitStatus);
+
+private slots:
+    void onTitleChanged(int what, const QString& caption);
+    void onStateSet(int state);
+    void onSendData(const char* data, int length);
+    void onReceiveBlock(const char* data, int length);
+
+private:
+    Emulation* _emulation;
+    ScreenWindow* _window;
+    Pty* _shellProcess;
+
+    QString _program;
+    QStringList _arguments;
+    QString _workingDirectory;
+    QStringList _environment;
+    QString _title;
+    bool _historyCompressed;
+};
+
+}
+
+#endif // HEADLESSSESSION_H
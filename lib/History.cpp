@@ -23,6 +23,7 @@
 
 // System
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <cstdlib>
 #include <cstdio>
@@ -236,6 +237,16 @@ bool HistoryScroll::hasScroll() const
   return true;
 }
 
+void HistoryScroll::addLines(const Character cells[], const int lengths[], const bool wrapped[], int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    addCells(cells, lengths[i]);
+    addLine(wrapped[i]);
+    cells += lengths[i];
+  }
+}
+
 // History Scroll File //////////////////////////////////////
 
 /*
@@ -360,6 +371,27 @@ void HistoryScrollBuffer::addLine(bool previousWrapped)
     _wrappedLine[bufferIndex(_usedLines-1)] = previousWrapped;
 }
 
+void HistoryScrollBuffer::addLines(const Character cells[], const int lengths[], const bool wrapped[], int count)
+{
+    if ( _maxLineCount == 0 )
+        return;
+
+    // the first lines of a batch larger than the buffer would only be
+    // overwritten by the rest of it, just move past their slots
+    const int skipped = qMax(0, count - _maxLineCount);
+    for ( int i = 0 ; i < skipped ; i++ )
+        cells += lengths[i];
+    _head = (_head + skipped) % _maxLineCount;
+    _usedLines = qMin(_usedLines + skipped, _maxLineCount);
+
+    for ( int i = skipped ; i < count ; i++ )
+    {
+        addCells(cells, lengths[i]);
+        addLine(wrapped[i]);
+        cells += lengths[i];
+    }
+}
+
 int HistoryScrollBuffer::getLines() const
 {
     return _usedLines;
@@ -821,6 +853,212 @@ bool CompactHistoryScroll::isWrappedLine ( int lineNumber ) const
 
 #endif
 
+// Compressed History Scroll //////////////////////////////////////
+
+// chunks are compressed while output arrives, favour speed over size
+static const int CompressionLevel = 1;
+
+CompressedHistoryScroll::CompressedHistoryScroll(unsigned int maxLineCount)
+  : HistoryScroll(new CompressedHistoryType(maxLineCount))
+   ,_firstChunk(0)
+   ,_firstLine(0)
+   ,_maxLineCount(0)
+{
+  setMaxNbLines(maxLineCount);
+}
+
+CompressedHistoryScroll::~CompressedHistoryScroll()
+{
+}
+
+QByteArray CompressedHistoryScroll::compress(const Chunk& chunk)
+{
+  const int lineCount = chunk.lineCount();
+  const int cellCount = chunk.cells.size();
+
+  // each field of the cells is stored on its own, long runs of the same
+  // colors and rendition compress better than whole cells
+  QByteArray raw;
+  raw.resize(2 * sizeof(int) + lineCount * (sizeof(int) + 1)
+             + cellCount * (sizeof(wchar_t) + sizeof(quint16) + 2 * sizeof(CharacterColor)));
+  char* out = raw.data();
+  const auto put = [&out](const void* data, size_t size) {
+    memcpy(out, data, size);
+    out += size;
+  };
+
+  put(&lineCount, sizeof(int));
+  put(&cellCount, sizeof(int));
+  put(chunk.lineEnds.constData(), lineCount * sizeof(int));
+  for (int i = 0; i < lineCount; i++)
+    *out++ = chunk.wrapped.testBit(i);
+
+  const Character* cells = chunk.cells.constData();
+  for (int i = 0; i < cellCount; i++)
+    put(&cells[i].character, sizeof(wchar_t));
+  for (int i = 0; i < cellCount; i++)
+    put(&cells[i].rendition, sizeof(quint16));
+  for (int i = 0; i < cellCount; i++)
+    put(&cells[i].foregroundColor, sizeof(CharacterColor));
+  for (int i = 0; i < cellCount; i++)
+    put(&cells[i].backgroundColor, sizeof(CharacterColor));
+  Q_ASSERT(out == raw.constData() + raw.size());
+
+  return qCompress(raw, CompressionLevel);
+}
+
+void CompressedHistoryScroll::uncompress(const QByteArray& data, Chunk& chunk)
+{
+  const QByteArray raw = qUncompress(data);
+  const char* in = raw.constData();
+  const auto get = [&in](void* data, size_t size) {
+    memcpy(data, in, size);
+    in += size;
+  };
+
+  int lineCount;
+  int cellCount;
+  get(&lineCount, sizeof(int));
+  get(&cellCount, sizeof(int));
+
+  chunk.lineEnds.resize(lineCount);
+  get(chunk.lineEnds.data(), lineCount * sizeof(int));
+  chunk.wrapped.resize(lineCount);
+  for (int i = 0; i < lineCount; i++)
+    chunk.wrapped.setBit(i, *in++ != 0);
+
+  chunk.cells.resize(cellCount);
+  Character* cells = chunk.cells.data();
+  for (int i = 0; i < cellCount; i++)
+    get(&cells[i].character, sizeof(wchar_t));
+  for (int i = 0; i < cellCount; i++)
+    get(&cells[i].rendition, sizeof(quint16));
+  for (int i = 0; i < cellCount; i++)
+    get(&cells[i].foregroundColor, sizeof(CharacterColor));
+  for (int i = 0; i < cellCount; i++)
+    get(&cells[i].backgroundColor, sizeof(CharacterColor));
+  Q_ASSERT(in == raw.constData() + raw.size());
+}
+
+const CompressedHistoryScroll::Chunk& CompressedHistoryScroll::findLine(int lineNumber, int& line) const
+{
+  Q_ASSERT( lineNumber >= 0 && lineNumber < getLines() );
+
+  const int position = lineNumber + _firstLine;
+  const int index = position / ChunkLines;
+  line = position % ChunkLines;
+
+  if ( index == _chunks.size() )
+    return _hotChunk;
+
+  const int number = _firstChunk + index;
+  for ( int i = 0 ; i < _cache.size() ; i++ )
+  {
+    if ( _cache.at(i).number == number )
+    {
+      _cache.move(i, 0);
+      return _cache.first().chunk;
+    }
+  }
+
+  if ( _cache.size() == CachedChunks )
+    _cache.removeLast();
+  _cache.prepend(CachedChunk{number, Chunk()});
+  uncompress(_chunks.at(index), _cache.first().chunk);
+  return _cache.first().chunk;
+}
+
+void CompressedHistoryScroll::addCells(const Character a[], int count)
+{
+  QVector<Character>& cells = _hotChunk.cells;
+  const int start = cells.size();
+  cells.resize(start + count);
+  std::copy(a, a + count, cells.begin() + start);
+
+  _hotChunk.lineEnds.append(cells.size());
+  _hotChunk.wrapped.resize(_hotChunk.lineCount());
+}
+
+void CompressedHistoryScroll::addLine(bool previousWrapped)
+{
+  Q_ASSERT( _hotChunk.lineCount() > 0 );
+  _hotChunk.wrapped.setBit(_hotChunk.lineCount() - 1, previousWrapped);
+
+  if ( _hotChunk.lineCount() == ChunkLines )
+    compressHotChunk();
+
+  dropLines();
+}
+
+void CompressedHistoryScroll::compressHotChunk()
+{
+  _chunks.append(compress(_hotChunk));
+
+  // keep the allocated memory for the next chunk
+  _hotChunk.cells.resize(0);
+  _hotChunk.lineEnds.resize(0);
+  _hotChunk.wrapped.resize(0);
+}
+
+void CompressedHistoryScroll::dropLines()
+{
+  if ( _maxLineCount == 0 )
+    return;
+
+  const int excess = getLines() - static_cast<int>(_maxLineCount);
+  if ( excess <= 0 )
+    return;
+
+  // lines are hidden until their whole chunk can be released
+  _firstLine += excess;
+  while ( _firstLine >= ChunkLines && !_chunks.isEmpty() )
+  {
+    const int number = _firstChunk;
+    _cache.erase(std::remove_if(_cache.begin(), _cache.end(),
+                                [number](const CachedChunk& cached) { return cached.number == number; }),
+                 _cache.end());
+    _chunks.removeFirst();
+    _firstChunk++;
+    _firstLine -= ChunkLines;
+  }
+}
+
+void CompressedHistoryScroll::setMaxNbLines(unsigned int lineCount)
+{
+  _maxLineCount = lineCount;
+  dropLines();
+  dynamic_cast<CompressedHistoryType*>(m_histType)->m_nbLines = lineCount;
+}
+
+int CompressedHistoryScroll::getLines() const
+{
+  return static_cast<int>(_chunks.size()) * ChunkLines + _hotChunk.lineCount() - _firstLine;
+}
+
+int CompressedHistoryScroll::getLineLen(int lineNumber) const
+{
+  int line;
+  const Chunk& chunk = findLine(lineNumber, line);
+  return chunk.lineEnds.at(line) - chunk.lineStart(line);
+}
+
+void CompressedHistoryScroll::getCells(int lineNumber, int startColumn, int count, Character buffer[]) const
+{
+  if ( count == 0 ) return;
+
+  int line;
+  const Chunk& chunk = findLine(lineNumber, line);
+  Q_ASSERT( startColumn >= 0 && startColumn + count <= chunk.lineEnds.at(line) - chunk.lineStart(line) );
+  std::copy_n(chunk.cells.constData() + chunk.lineStart(line) + startColumn, count, buffer);
+}
+
+bool CompressedHistoryScroll::isWrappedLine(int lineNumber) const
+{
+  int line;
+  const Chunk& chunk = findLine(lineNumber, line);
+  return chunk.wrapped.testBit(line);
+}
+
 //////////////////////////////////////////////////////////////////////
 // History Types
 //////////////////////////////////////////////////////////////////////
@@ -1030,4 +1268,54 @@ HistoryScroll* CompactHistoryType::scroll ( HistoryScroll *old ) const
   return new CompactHistoryScroll ( m_nbLines );
 }
 
-#endif
\ No newline at end of file
+#endif
+
+//////////////////////////////
+
+CompressedHistoryType::CompressedHistoryType(unsigned int nbLines)
+  : m_nbLines(nbLines)
+{
+}
+
+bool CompressedHistoryType::isEnabled() const
+{
+  return true;
+}
+
+int CompressedHistoryType::maximumLineCount() const
+{
+  return m_nbLines;
+}
+
+HistoryScroll* CompressedHistoryType::scroll(HistoryScroll *old) const
+{
+  if (old)
+  {
+    CompressedHistoryScroll *oldCompressed = dynamic_cast<CompressedHistoryScroll*>(old);
+    if (oldCompressed)
+    {
+      oldCompressed->setMaxNbLines(m_nbLines);
+      return oldCompressed;
+    }
+  }
+
+  HistoryScroll *newScroll = new CompressedHistoryScroll(m_nbLines);
+  if (old)
+  {
+    int lines = old->getLines();
+    int startLine = 0;
+    if (m_nbLines > 0 && lines > static_cast<int>(m_nbLines))
+      startLine = lines - m_nbLines;
+
+    QVector<Character> line;
+    for (int i = startLine; i < lines; i++)
+    {
+      line.resize(old->getLineLen(i));
+      old->getCells(i, 0, line.size(), line.data());
+      newScroll->addCells(line.constData(), line.size());
+      newScroll->addLine(old->isWrappedLine(i));
+    }
+    delete old;
+  }
+  return newScroll;
+}
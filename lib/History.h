@@ -22,7 +22,9 @@
 #define TEHISTORY_H
 
 // Qt
+#include <QBitArray>
 #include <QBitRef>
+#include <QByteArray>
 #include <QHash>
 #include <QVector>
 #include <QTemporaryFile>
@@ -32,6 +34,7 @@
 
 // Konsole
 #include "Character.h"
+#include "qtermwidget_core_export.h"
 #ifndef Q_OS_WIN
 #include "BlockArray.h"
 
@@ -119,6 +122,12 @@ public:
 
   virtual void addLine(bool previousWrapped=false) = 0;
 
+  // adds 'count' complete lines at once, line i is made of the next
+  // lengths[i] cells of 'cells' and wrapped into the line following it
+  // if wrapped[i] is true.  backends may skip lines which the same call
+  // pushes out of the history again.
+  virtual void addLines(const Character cells[], const int lengths[], const bool wrapped[], int count);
+
   //
   // FIXME:  Passing around constant references to HistoryType instances
   // is very unsafe, because those references will no longer
@@ -180,6 +189,7 @@ public:
   void addCells(const Character a[], int count) override;
   void addCellsVector(const QVector<Character>& cells) override;
   void addLine(bool previousWrapped=false) override;
+  void addLines(const Character cells[], const int lengths[], const bool wrapped[], int count) override;
 
   void setMaxNbLines(unsigned int nbLines);
   unsigned int maxNbLines() const { return _maxLineCount; }
@@ -290,7 +300,7 @@ public:
 
   CharacterColor fgColor, bgColor;
   quint16 startPos;
-  quint8 rendition;
+  quint16 rendition;
 };
 
 #ifndef Q_OS_WIN
@@ -395,11 +405,72 @@ private:
 
 #endif
 
+//////////////////////////////////////////////////////////////////////
+// History using compressed storage
+// Lines are stored in chunks of a fixed number of lines.  Only the chunk
+// being filled is kept as it is, full chunks are compressed and expanded
+// again when they are read, keeping the last few expanded chunks around
+// for scrolling back.  Suited to long, repetitive output.
+//////////////////////////////////////////////////////////////////////
+class CompressedHistoryScroll : public HistoryScroll
+{
+public:
+  CompressedHistoryScroll(unsigned int maxNbLines = 0);
+  ~CompressedHistoryScroll() override;
+
+  int  getLines() const override;
+  int  getLineLen(int lineno) const override;
+  void getCells(int lineno, int colno, int count, Character res[]) const override;
+  bool isWrappedLine(int lineno) const override;
+
+  void addCells(const Character a[], int count) override;
+  void addLine(bool previousWrapped=false) override;
+
+  // a limit of 0 keeps every line
+  void setMaxNbLines(unsigned int nbLines);
+  unsigned int maxNbLines() const { return _maxLineCount; }
+
+private:
+  enum { ChunkLines = 256, CachedChunks = 8 };
+
+  struct Chunk
+  {
+    QVector<Character> cells;
+    QVector<int> lineEnds;   // the end of each line in 'cells'
+    QBitArray wrapped;
+
+    int lineCount() const { return lineEnds.size(); }
+    int lineStart(int line) const { return line == 0 ? 0 : lineEnds[line - 1]; }
+  };
+
+  struct CachedChunk
+  {
+    int number;
+    Chunk chunk;
+  };
+
+  static QByteArray compress(const Chunk& chunk);
+  static void uncompress(const QByteArray& data, Chunk& chunk);
+
+  // returns the chunk holding 'lineno' and sets 'line' to its index there
+  const Chunk& findLine(int lineno, int& line) const;
+  void compressHotChunk();
+  void dropLines();
+
+  QVector<QByteArray> _chunks; // the full chunks, oldest first
+  int _firstChunk;             // number of the chunk at _chunks[0]
+  int _firstLine;              // lines dropped from the start of the first chunk
+  Chunk _hotChunk;             // the chunk lines are added to
+  unsigned int _maxLineCount;
+
+  mutable QList<CachedChunk> _cache; // most recently used first
+};
+
 //////////////////////////////////////////////////////////////////////
 // History type
 //////////////////////////////////////////////////////////////////////
 
-class HistoryType
+class QTERMWIDGET_CORE_EXPORT HistoryType
 {
 public:
   HistoryType();
@@ -423,7 +494,7 @@ public:
   virtual HistoryScroll* scroll(HistoryScroll *) const = 0;
 };
 
-class HistoryTypeNone : public HistoryType
+class QTERMWIDGET_CORE_EXPORT HistoryTypeNone : public HistoryType
 {
 public:
   HistoryTypeNone();
@@ -436,7 +507,7 @@ public:
 
 #ifndef Q_OS_WIN
 
-class HistoryTypeBlockArray : public HistoryType
+class QTERMWIDGET_CORE_EXPORT HistoryTypeBlockArray : public HistoryType
 {
 public:
   HistoryTypeBlockArray(size_t size);
@@ -451,7 +522,7 @@ protected:
 };
 #endif
 
-class HistoryTypeFile : public HistoryType
+class QTERMWIDGET_CORE_EXPORT HistoryTypeFile : public HistoryType
 {
 public:
   HistoryTypeFile(const QString& fileName=QString());
@@ -467,7 +538,7 @@ protected:
 };
 
 
-class HistoryTypeBuffer : public HistoryType
+class QTERMWIDGET_CORE_EXPORT HistoryTypeBuffer : public HistoryType
 {
     friend class HistoryScrollBuffer;
 
@@ -485,7 +556,7 @@ protected:
 
 #ifndef Q_OS_WIN
 
-class CompactHistoryType : public HistoryType
+class QTERMWIDGET_CORE_EXPORT CompactHistoryType : public HistoryType
 {
 public:
   CompactHistoryType(unsigned int size);
@@ -501,6 +572,22 @@ protected:
 
 #endif
 
+class QTERMWIDGET_CORE_EXPORT CompressedHistoryType : public HistoryType
+{
+    friend class CompressedHistoryScroll;
+
+public:
+  CompressedHistoryType(unsigned int nbLines = 0);
+
+  bool isEnabled() const override;
+  int maximumLineCount() const override;
+
+  HistoryScroll* scroll(HistoryScroll *) const override;
+
+protected:
+  unsigned int m_nbLines;
+};
+
 }
 
 #endif // TEHISTORY_H
@@ -31,7 +31,7 @@
 
 // Konsole
 //#include "konsole_export.h"
-#define KONSOLEPRIVATE_EXPORT
+#include "qtermwidget_core_export.h"
 
 class QIODevice;
 class QTextStream;
@@ -52,7 +52,7 @@ namespace Konsole
  * (Shift,Ctrl,Alt,Meta etc.) and state flags which indicate the state
  * which the terminal must be in for the key sequence to apply.
  */
-class KeyboardTranslator
+class QTERMWIDGET_CORE_EXPORT KeyboardTranslator
 {
 public:
     /**
@@ -456,7 +456,7 @@ private:
  * Manages the keyboard translations available for use by terminal sessions,
  * see KeyboardTranslator.
  */
-class KONSOLEPRIVATE_EXPORT KeyboardTranslatorManager
+class QTERMWIDGET_CORE_EXPORT KeyboardTranslatorManager
 {
 public:
     /**
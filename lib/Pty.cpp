@@ -325,12 +325,18 @@ void Pty::sendData(const char* data, int length)
 
 void Pty::dataReceived()
 {
-    QByteArray data = pty()->readAll();
-    if (data.isEmpty())
+    // Hand the chunks of the pty's read buffer to the receivers in place
+    // and release each one only after it has been processed, rather than
+    // copying everything into a temporary QByteArray first.
+    KPtyDevice* device = pty();
+    forever
     {
-        return;
+        const QByteArrayView chunk = device->peekChunk();
+        if (chunk.isEmpty())
+            break;
+        emit receivedData(chunk.constData(), static_cast<int>(chunk.size()));
+        device->releaseChunk(chunk.size());
     }
-    emit receivedData(data.constData(),data.size());
 }
 
 int Pty::foregroundProcessGroup() const
@@ -354,6 +360,21 @@ void Pty::closePty()
     pty()->close();
 }
 
+void Pty::setThreadedReading(bool threaded)
+{
+    pty()->setThreadedReading(threaded);
+}
+
+bool Pty::isThreadedReading() const
+{
+    return pty()->isThreadedReading();
+}
+
+void Pty::setReadingSuspended(bool suspended)
+{
+    pty()->setSuspended(suspended);
+}
+
 #else // Windows backend
 
 #include "ptyqt/conptyprocess.h"
@@ -483,6 +504,21 @@ void Pty::closePty()
     }
 }
 
+void Pty::setThreadedReading(bool)
+{
+    // ConPTY output is already read by the IPtyProcess backend
+}
+
+bool Pty::isThreadedReading() const
+{
+    return false;
+}
+
+void Pty::setReadingSuspended(bool)
+{
+    // not supported by the ConPTY backend
+}
+
 int Pty::foregroundProcessGroup() const
 {
     return 0;
@@ -47,6 +47,8 @@
 #include "ptyqt/iptyprocess.h"
 #endif
 
+#include "qtermwidget_core_export.h"
+
 namespace Konsole {
 
 #ifdef WIN32
@@ -68,7 +70,7 @@ namespace Konsole {
  * To start the terminal process, call the start() method
  * with the program name and appropriate arguments.
  */
-class Pty: public ParentClass
+class QTERMWIDGET_CORE_EXPORT Pty: public ParentClass
 {
 Q_OBJECT
 
@@ -187,6 +189,27 @@ Q_OBJECT
      */
     void closePty();
 
+    /**
+     * Sets whether output from the terminal process is read on a dedicated
+     * I/O thread, so that a busy GUI thread does not stall the process.
+     * receivedData() is still emitted in the thread this object lives in.
+     *
+     * See KPtyDevice::setThreadedReading()
+     */
+    void setThreadedReading(bool threaded);
+
+    /** Returns whether output is read on a dedicated I/O thread. */
+    bool isThreadedReading() const;
+
+    /**
+     * Stops or resumes reading output from the terminal process, e.g.
+     * while the consumer of receivedData() is lagging behind.  The process
+     * blocks once the pty's buffer is full.
+     *
+     * See KPtyDevice::setSuspended()
+     */
+    void setReadingSuspended(bool suspended);
+
 #ifdef Q_OS_WIN
     int processId() const
     {
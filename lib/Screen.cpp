@@ -28,8 +28,11 @@
 #include <cstdlib>
 #include <cstring>
 #include <cctype>
+#include <utility>
+#include <algorithm>
 
 // Qt
+#include <QDataStream>
 #include <QTextStream>
 #include <QDate>
 
@@ -49,7 +52,7 @@ using namespace Konsole;
 //offset from the beginning of the block.  For efficiency reasons this
 //is no longer the case.
 //Many internal parts of this class still use this representation for parameters and so on,
-//notably moveImage() and clearImage().
+//notably clearImage().
 //This macro converts from an X,Y position into an image offset.
 #ifndef loc
 #define loc(X,Y) ((Y)*columns+(X))
@@ -66,9 +69,11 @@ Character Screen::defaultChar = Character(' ',
     Screen::Screen(int l, int c)
 : lines(l),
     columns(c),
-    screenLines(new ImageLine[lines+1] ),
+    screenLines(new ImageLine[lines] ),
+    _firstLine(0),
     _scrolledLines(0),
     _droppedLines(0),
+    _dirtyLines(l, true),
     history(new HistoryScrollNone()),
     cuX(0), cuY(0),
     currentRendition(0),
@@ -78,8 +83,8 @@ Character Screen::defaultChar = Character(' ',
     effectiveForeground(CharacterColor()), effectiveBackground(CharacterColor()), effectiveRendition(0),
     lastPos(-1)
 {
-    lineProperties.resize(lines+1);
-    for (int i=0;i<lines+1;i++)
+    lineProperties.resize(lines);
+    for (int i=0;i<lines;i++)
         lineProperties[i]=LINE_DEFAULT;
 
     initTabStops();
@@ -227,29 +232,32 @@ void Screen::deleteChars(int n)
         n = 1;
 
     // if cursor is beyond the end of the line there is nothing to do
-    if ( cuX >= screenLines[cuY].count() )
+    if ( cuX >= screenLine(cuY).count() )
         return;
 
-    if ( cuX+n > screenLines[cuY].count() )
-        n = screenLines[cuY].count() - cuX;
+    if ( cuX+n > screenLine(cuY).count() )
+        n = screenLine(cuY).count() - cuX;
 
     Q_ASSERT( n >= 0 );
-    Q_ASSERT( cuX+n <= screenLines[cuY].count() );
+    Q_ASSERT( cuX+n <= screenLine(cuY).count() );
 
-    screenLines[cuY].remove(cuX,n);
+    screenLine(cuY).remove(cuX,n);
+    setLineDirty(cuY);
 }
 
 void Screen::insertChars(int n)
 {
     if (n == 0) n = 1; // Default
 
-    if ( screenLines[cuY].size() < cuX )
-        screenLines[cuY].resize(cuX);
+    if ( screenLine(cuY).size() < cuX )
+        screenLine(cuY).resize(cuX);
 
-    screenLines[cuY].insert(cuX,n,' ');
+    screenLine(cuY).insert(cuX,n,' ');
 
-    if ( screenLines[cuY].count() > columns )
-        screenLines[cuY].resize(columns);
+    if ( screenLine(cuY).count() > columns )
+        screenLine(cuY).resize(columns);
+
+    setLineDirty(cuY);
 }
 
 void Screen::repeatChars(int count)
@@ -292,6 +300,7 @@ void Screen::setMode(int m)
     switch(m)
     {
         case MODE_Origin : cuX = 0; cuY = _topMargin; break; //FIXME: home
+        case MODE_Screen : setAllLinesDirty(); break;
     }
 }
 
@@ -301,6 +310,7 @@ void Screen::resetMode(int m)
     switch(m)
     {
         case MODE_Origin : cuX = 0; cuY = 0; break; //FIXME: home
+        case MODE_Screen : setAllLinesDirty(); break;
     }
 }
 
@@ -351,27 +361,38 @@ void Screen::resizeImage(int new_lines, int new_columns)
         }
     }
 
-    // create new screen lines and copy from old to new
-
-    ImageLine* newScreenLines = new ImageLine[new_lines+1];
-    for (int i=0; i < qMin(lines,new_lines+1) ;i++)
-        newScreenLines[i]=screenLines[i];
-    for (int i=lines;(i > 0) && (i<new_lines+1);i++)
-        newScreenLines[i].resize( new_columns );
+    // create new screen lines and move the old ones over, starting the
+    // ring of lines at the first of them again
 
-    lineProperties.resize(new_lines+1);
-    for (int i=lines;(i > 0) && (i<new_lines+1);i++)
-        lineProperties[i] = LINE_DEFAULT;
+    ImageLine* newScreenLines = new ImageLine[new_lines];
+    QVarLengthArray<LineProperty,64> newLineProperties(new_lines);
+    for (int i=0; i < new_lines ;i++)
+    {
+        if (i < lines)
+        {
+            newScreenLines[i].swap(screenLine(i));
+            newLineProperties[i] = lineProperty(i);
+        }
+        else
+        {
+            newScreenLines[i].resize( new_columns );
+            newLineProperties[i] = LINE_DEFAULT;
+        }
+    }
 
     clearSelection();
 
     delete[] screenLines;
     screenLines = newScreenLines;
+    lineProperties = newLineProperties;
+    _firstLine = 0;
 
     lines = new_lines;
     columns = new_columns;
     cuX = qMin(cuX,columns-1);
     cuY = qMin(cuY,lines-1);
+    _dirtyLines.resize(lines);
+    setAllLinesDirty();
 
     // FIXME: try to keep values, evtl.
     _topMargin=0;
@@ -455,24 +476,10 @@ void Screen::copyFromHistory(Character* dest, int startLine, int count) const
     for (int line = startLine; line < startLine + count; line++)
     {
         const int length = qMin(columns,history->getLineLen(line));
-        const int destLineOffset  = (line-startLine)*columns;
-
-        history->getCells(line,0,length,dest + destLineOffset);
+        Character* const destLine = dest + (line-startLine)*columns;
 
-        for (int column = length; column < columns; column++)
-            dest[destLineOffset+column] = defaultChar;
-
-        // invert selected text
-        if (selBegin !=-1)
-        {
-            for (int column = 0; column < columns; column++)
-            {
-                if (isSelected(column,line))
-                {
-                    reverseRendition(dest[destLineOffset + column]);
-                }
-            }
-        }
+        history->getCells(line,0,length,destLine);
+        std::fill_n(destLine + length, columns - length, defaultChar);
     }
 }
 
@@ -482,21 +489,13 @@ void Screen::copyFromScreen(Character* dest , int startLine , int count) const
 
     for (int line = startLine; line < (startLine+count) ; line++)
     {
-        int srcLineStartIndex  = line*columns;
-        int destLineStartIndex = (line-startLine)*columns;
-
-        for (int column = 0; column < columns; column++)
-        {
-            int srcIndex = srcLineStartIndex + column;
-            int destIndex = destLineStartIndex + column;
-
-            dest[destIndex] = screenLines[srcIndex/columns].value(srcIndex%columns,defaultChar);
-
-            // invert selected text
-            if (selBegin != -1 && isSelected(column,line + history->getLines()))
-                reverseRendition(dest[destIndex]);
-        }
+        // lines only hold the characters written to them, the rest is blank
+        const ImageLine& srcLine = screenLine(line);
+        const int length = qMin(columns, int(srcLine.count()));
+        Character* const destLine = dest + (line-startLine)*columns;
 
+        memcpy(destLine, srcLine.constData(), length * sizeof(Character));
+        std::fill_n(destLine + length, columns - length, defaultChar);
     }
 }
 
@@ -530,9 +529,11 @@ void Screen::getImage( Character* dest, int size, int startLine, int endLine ) c
             reverseRendition(dest[i]); // for reverse display
     }
 
-    // mark the character at the current cursor position
-    int cursorIndex = loc(cuX, cuY + linesInHistoryBuffer);
-    if(getMode(MODE_Cursor) && cursorIndex < columns*mergedLines)
+    // mark the character at the current cursor position, the lines
+    // copied do not need to start at the top of the screen
+    const int cursorLine = cuY + history->getLines() - startLine;
+    int cursorIndex = loc(cuX, cursorLine);
+    if(getMode(MODE_Cursor) && cursorLine >= 0 && cursorIndex < columns*mergedLines)
         dest[cursorIndex].rendition |= RE_CURSOR;
 }
 
@@ -563,13 +564,132 @@ QVector<LineProperty> Screen::getLineProperties( int startLine , int endLine ) c
     const int firstScreenLine = startLine + linesInHistory - history->getLines();
     for (int line = firstScreenLine; line < firstScreenLine+linesInScreen; line++)
     {
-        result[index]=lineProperties[line];
+        result[index]=lineProperty(line);
         index++;
     }
 
     return result;
 }
 
+// cells of extended characters are stored with their code points, the
+// hash in the character field is only valid within this process
+static void writeCharacter(QDataStream& stream, const Character& character)
+{
+    stream << quint32(character.character) << quint16(character.rendition)
+           << character.foregroundColor << character.backgroundColor;
+
+    if (character.rendition & RE_EXTENDED_CHAR)
+    {
+        ushort length = 0;
+        const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(character.character, length);
+        stream << quint16(length);
+        for (int i = 0; i < length; i++)
+            stream << quint32(chars[i]);
+    }
+}
+
+static void readCharacter(QDataStream& stream, Character& character)
+{
+    quint32 value = 0;
+    stream >> value >> character.rendition
+           >> character.foregroundColor >> character.backgroundColor;
+    character.character = value;
+
+    if (character.rendition & RE_EXTENDED_CHAR)
+    {
+        quint16 length = 0;
+        stream >> length;
+        QVarLengthArray<uint, 8> chars(length);
+        for (int i = 0; i < length; i++)
+            stream >> chars[i];
+        character.character = length > 0
+                ? ExtendedCharTable::instance.createExtendedChar(chars.data(), length) : 0;
+    }
+}
+
+void Screen::saveState(QDataStream& stream) const
+{
+    stream << qint32(lines) << qint32(columns);
+    for (int i = 0; i < lines; i++)
+    {
+        const ImageLine& line = screenLine(i);
+        stream << lineProperty(i) << qint32(line.size());
+        for (const Character& character : line)
+            writeCharacter(stream, character);
+    }
+
+    stream << qint32(cuX) << qint32(cuY)
+           << currentForeground << currentBackground << quint16(currentRendition)
+           << qint32(_topMargin) << qint32(_bottomMargin);
+    for (int i = 0; i < MODES_SCREEN; i++)
+        stream << currentModes[i] << savedModes[i];
+    stream << tabStops;
+    stream << qint32(savedState.cursorColumn) << qint32(savedState.cursorLine)
+           << quint16(savedState.rendition) << savedState.foreground << savedState.background;
+    stream << quint16(lastDrawnChar);
+}
+
+bool Screen::restoreState(QDataStream& stream)
+{
+    qint32 newLines = 0;
+    qint32 newColumns = 0;
+    stream >> newLines >> newColumns;
+    if (stream.status() != QDataStream::Ok || newLines < 1 || newColumns < 1)
+        return false;
+
+    if (newLines != lines || newColumns != columns)
+    {
+        // the image is replaced below, so there is nothing worth
+        // scrolling into the history while resizing
+        cuY = 0;
+        resizeImage(newLines, newColumns);
+    }
+
+    for (int i = 0; i < lines; i++)
+    {
+        qint32 length = 0;
+        stream >> lineProperty(i) >> length;
+        if (stream.status() != QDataStream::Ok || length < 0 || length > columns + 1)
+            return false;
+
+        ImageLine& line = screenLine(i);
+        line.resize(length);
+        for (Character& character : line)
+            readCharacter(stream, character);
+    }
+
+    qint32 cursorX = 0, cursorY = 0, topMargin = 0, bottomMargin = 0;
+    stream >> cursorX >> cursorY
+           >> currentForeground >> currentBackground >> currentRendition
+           >> topMargin >> bottomMargin;
+    for (int i = 0; i < MODES_SCREEN; i++)
+        stream >> currentModes[i] >> savedModes[i];
+    stream >> tabStops;
+    qint32 savedColumn = 0, savedLine = 0;
+    stream >> savedColumn >> savedLine
+           >> savedState.rendition >> savedState.foreground >> savedState.background;
+    quint16 drawnChar = 0;
+    stream >> drawnChar;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    cuX = qBound(0, int(cursorX), columns - 1);
+    cuY = qBound(0, int(cursorY), lines - 1);
+    _bottomMargin = qBound(0, int(bottomMargin), lines - 1);
+    _topMargin = qBound(0, int(topMargin), _bottomMargin);
+    savedState.cursorColumn = qBound(0, int(savedColumn), columns - 1);
+    savedState.cursorLine = qBound(0, int(savedLine), lines - 1);
+    lastDrawnChar = drawnChar;
+    if (tabStops.size() != columns)
+        initTabStops();
+
+    lastPos = -1;
+    clearSelection();
+    updateEffectiveRendition();
+    setAllLinesDirty();
+    return true;
+}
+
 void Screen::reset(bool clearScreen)
 {
     setMode(MODE_Wrap  ); saveMode(MODE_Wrap  );  // wrap at end of margin
@@ -600,8 +720,8 @@ void Screen::backspace()
     cuX = qMin(columns-1,cuX); // nowrap!
     cuX = qMax(0,cuX-1);
 
-    if (screenLines[cuY].size() < cuX+1)
-        screenLines[cuY].resize(cuX+1);
+    if (screenLine(cuY).size() < cuX+1)
+        screenLine(cuY).resize(cuX+1);
 }
 
 void Screen::tab(int n)
@@ -689,7 +809,7 @@ void Screen::displayCharacter(wchar_t c)
         if (w == 0 && QChar(c).category() != QChar::Mark_NonSpacing)
             return;
         // Find previous "real character" to try to combine with
-        int charToCombineWithX = qMin(cuX, screenLines[cuY].length());
+        int charToCombineWithX = qMin(cuX, screenLine(cuY).length());
         int charToCombineWithY = cuY;
         bool previousChar = true;
         do {
@@ -697,10 +817,10 @@ void Screen::displayCharacter(wchar_t c)
             {
                 --charToCombineWithX;
             }
-            else if (charToCombineWithY > 0 && lineProperties.at(charToCombineWithY - 1) & LINE_WRAPPED)
+            else if (charToCombineWithY > 0 && lineProperty(charToCombineWithY - 1) & LINE_WRAPPED)
             { // Try previous line
                 --charToCombineWithY;
-                charToCombineWithX = screenLines[charToCombineWithY].length() - 1;
+                charToCombineWithX = screenLine(charToCombineWithY).length() - 1;
             }
             else
             {
@@ -715,7 +835,7 @@ void Screen::displayCharacter(wchar_t c)
                 previousChar = false;
                 break;
             }
-        } while (w == 0 && screenLines[charToCombineWithY][charToCombineWithX] == 0);
+        } while (w == 0 && screenLine(charToCombineWithY)[charToCombineWithX] == 0);
 
         if (!previousChar)
         {
@@ -726,7 +846,7 @@ void Screen::displayCharacter(wchar_t c)
             goto notcombine;
         }
 
-        Character& currentChar = screenLines[charToCombineWithY][charToCombineWithX];
+        Character& currentChar = screenLine(charToCombineWithY)[charToCombineWithX];
 
         if (w > 0 && !isRegionalIndicator(currentChar.character))
         {
@@ -746,7 +866,8 @@ void Screen::displayCharacter(wchar_t c)
                 {
                     if (getMode(MODE_Wrap))
                     {
-                        lineProperties[cuY] = (LineProperty)(lineProperties[cuY] | LINE_WRAPPED);
+                        lineProperty(cuY) = (LineProperty)(lineProperty(cuY) | LINE_WRAPPED);
+                        setLineDirty(cuY);
                         nextLine();
                     }
                     else
@@ -755,13 +876,13 @@ void Screen::displayCharacter(wchar_t c)
                     }
                 }
 
-                if (screenLines[cuY].size() < cuX + 1)
+                if (screenLine(cuY).size() < cuX + 1)
                 {
-                    screenLines[cuY].resize(cuX + 1);
+                    screenLine(cuY).resize(cuX + 1);
                 }
 
                 // NOTE: This is needed for correct selection.
-                Character& ch = screenLines[cuY][cuX];
+                Character& ch = screenLine(cuY)[cuX];
                 ch.character = 0;
                 ch.foregroundColor = effectiveForeground;
                 ch.backgroundColor = effectiveBackground;
@@ -794,6 +915,8 @@ void Screen::displayCharacter(wchar_t c)
                 currentChar.character = ExtendedCharTable::instance.createExtendedChar(chars.get(), extendedCharLength + 1);
             }
         }
+        setLineDirty(charToCombineWithY);
+        setLineDirty(cuY);
         return;
     }
 
@@ -802,7 +925,8 @@ notcombine:
     {
         if (getMode(MODE_Wrap))
         {
-            lineProperties[cuY] = (LineProperty)(lineProperties[cuY] | LINE_WRAPPED);
+            lineProperty(cuY) = (LineProperty)(lineProperty(cuY) | LINE_WRAPPED);
+            setLineDirty(cuY);
             nextLine();
         }
         else
@@ -812,10 +936,10 @@ notcombine:
     }
 
     // ensure current line vector has enough elements
-    int size = screenLines[cuY].size();
+    int size = screenLine(cuY).size();
     if (size < cuX+w)
     {
-        screenLines[cuY].resize(cuX+w);
+        screenLine(cuY).resize(cuX+w);
     }
 
     if (getMode(MODE_Insert)) insertChars(w);
@@ -825,12 +949,13 @@ notcombine:
     // check if selection is still valid.
     checkSelection(lastPos, lastPos);
 
-    Character& currentChar = screenLines[cuY][cuX];
+    Character& currentChar = screenLine(cuY)[cuX];
 
     currentChar.character = c;
     currentChar.foregroundColor = effectiveForeground;
     currentChar.backgroundColor = effectiveBackground;
     currentChar.rendition = effectiveRendition;
+    setLineDirty(cuY);
 
     lastDrawnChar = c;
 
@@ -840,10 +965,10 @@ notcombine:
     {
         i++;
 
-        if ( screenLines[cuY].size() < cuX + i + 1 )
-            screenLines[cuY].resize(cuX+i+1);
+        if ( screenLine(cuY).size() < cuX + i + 1 )
+            screenLine(cuY).resize(cuX+i+1);
 
-        Character& ch = screenLines[cuY][cuX + i];
+        Character& ch = screenLine(cuY)[cuX + i];
         ch.character = 0;
         ch.foregroundColor = effectiveForeground;
         ch.backgroundColor = effectiveBackground;
@@ -854,6 +979,197 @@ notcombine:
     cuX = newCursorX;
 }
 
+// printable ASCII is always exactly one column wide and never combines
+static inline bool isSingleColumnChar(wchar_t c)
+{
+    return c >= 0x20 && c < 0x7f;
+}
+
+void Screen::displayString(const wchar_t* text, int length)
+{
+    if (getMode(MODE_Insert))
+    {
+        for (int i = 0; i < length; i++)
+            displayCharacter(text[i]);
+        return;
+    }
+
+    int i = 0;
+    while (i < length)
+    {
+        if (!isSingleColumnChar(text[i]))
+        {
+            displayCharacter(text[i++]);
+            continue;
+        }
+
+        // wrap before putting the character, see displayCharacter()
+        if (cuX + 1 > columns)
+        {
+            if (getMode(MODE_Wrap))
+            {
+                lineProperty(cuY) = (LineProperty)(lineProperty(cuY) | LINE_WRAPPED);
+                setLineDirty(cuY);
+                nextLine();
+            }
+            else
+            {
+                cuX = columns-1;
+            }
+        }
+
+        // the part of the run which fits on the current line
+        int count = 1;
+        while (i + count < length && cuX + count < columns && isSingleColumnChar(text[i + count]))
+            count++;
+
+        if (screenLine(cuY).size() < cuX + count)
+            screenLine(cuY).resize(cuX + count);
+
+        checkSelection(loc(cuX, cuY), loc(cuX + count - 1, cuY));
+
+        Character* dest = screenLine(cuY).data() + cuX;
+        for (int j = 0; j < count; j++)
+        {
+            dest[j].character = text[i + j];
+            dest[j].foregroundColor = effectiveForeground;
+            dest[j].backgroundColor = effectiveBackground;
+            dest[j].rendition = effectiveRendition;
+        }
+        setLineDirty(cuY);
+
+        lastPos = loc(cuX + count - 1, cuY);
+        lastDrawnChar = text[i + count - 1];
+
+        cuX += count;
+        i += count;
+    }
+}
+
+// the number of screen rows a line of single column characters takes
+static inline int rowsOfLine(int length, int columns)
+{
+    return length == 0 ? 1 : (length + columns - 1) / columns;
+}
+
+void Screen::displayLines(const wchar_t* text, const int starts[], const int lengths[], int count)
+{
+    int rows = 0;
+    for (int i = 0; i < count; i++)
+        rows += rowsOfLine(lengths[i], columns);
+
+    int i = 0;
+    while (i < count)
+    {
+        // rows which would all scroll off the screen before the last line
+        // is complete need not be written to it
+        if (rows >= lines && canBatchLines())
+        {
+            batchLines(text, starts + i, lengths + i, count - i, rows);
+            return;
+        }
+
+        displayString(text + starts[i], lengths[i]);
+        toStartOfLine();
+        newLine();
+        rows -= rowsOfLine(lengths[i], columns);
+        i++;
+    }
+}
+
+bool Screen::canBatchLines() const
+{
+    return _topMargin == 0 && _bottomMargin == lines - 1
+        && cuY == lines - 1 && cuX == 0
+        && screenLine(cuY).isEmpty() && lineProperty(cuY) == 0
+        && selBegin == -1
+        && getMode(MODE_Wrap) && !getMode(MODE_Insert)
+        // scrolling clears the new bottom line to an empty line
+        && Character(' ', currentForeground, currentBackground, DEFAULT_RENDITION) == Character();
+}
+
+void Screen::batchLines(const wchar_t* text, const int starts[], const int lengths[],
+                        int count, int rows)
+{
+    Q_ASSERT( rows >= lines );
+
+    // Line by line, every row would first be written to the empty bottom
+    // line and then scroll up, so the screen plus the produced rows form
+    // one sequence: the top 'rows' of it end up in the history, the last
+    // 'lines' of it, that is all but the first 'rows - lines + 1' produced
+    // rows and an empty bottom line, on the screen.
+    const int histRows = rows - lines + 1;
+
+    QVector<Character> cells;
+    QVector<int> rowLengths;
+    QVector<bool> rowWrapped;
+    const bool keepHistory = hasScroll();
+    if (keepHistory)
+    {
+        rowLengths.reserve(lines - 1 + histRows);
+        rowWrapped.reserve(lines - 1 + histRows);
+        for (int y = 0; y < lines - 1; y++)
+        {
+            cells += screenLine(y);
+            rowLengths << screenLine(y).size();
+            rowWrapped << bool(lineProperty(y) & LINE_WRAPPED);
+        }
+    }
+
+    const Character blank(' ', effectiveForeground, effectiveBackground, effectiveRendition);
+    int row = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const wchar_t* chars = text + starts[i];
+        const int lineRows = rowsOfLine(lengths[i], columns);
+        for (int r = 0; r < lineRows; r++, row++)
+        {
+            const int first = r * columns;
+            const int length = qMin(columns, lengths[i] - first);
+            const bool wrapped = r < lineRows - 1;
+
+            Character* dest;
+            if (row < histRows)
+            {
+                if (!keepHistory)
+                    continue;
+                cells.resize(cells.size() + length);
+                dest = cells.data() + cells.size() - length;
+                rowLengths << length;
+                rowWrapped << wrapped;
+            }
+            else
+            {
+                const int y = row - histRows;
+                ImageLine& line = screenLine(y);
+                line.resize(length);
+                dest = line.data();
+                lineProperty(y) = wrapped ? LINE_WRAPPED : 0;
+            }
+
+            for (int j = 0; j < length; j++)
+            {
+                dest[j] = blank;
+                dest[j].character = chars[first + j];
+            }
+        }
+        if (lengths[i] > 0)
+            lastDrawnChar = chars[lengths[i] - 1];
+    }
+
+    if (keepHistory)
+    {
+        const int oldHistLines = history->getLines();
+        history->addLines(cells.constData(), rowLengths.constData(), rowWrapped.constData(), int(rowLengths.size()));
+        _droppedLines += rows - (history->getLines() - oldHistLines);
+    }
+
+    _scrolledLines -= rows;
+    _lastScrolledRegion = QRect(0,0,columns-1,lines-1);
+    lastPos = -1;
+    setLinesDirty(0, lines - 1);
+}
+
 void Screen::compose(const QString& /*compose*/)
 {
     Q_ASSERT( 0 /*Not implemented yet*/ );
@@ -879,6 +1195,18 @@ void Screen::resetDroppedLines()
 {
     _droppedLines = 0;
 }
+const QBitArray& Screen::dirtyLines() const
+{
+    return _dirtyLines;
+}
+void Screen::setAllLinesDirty()
+{
+    _dirtyLines.fill(true);
+}
+void Screen::resetDirtyLines()
+{
+    _dirtyLines.fill(false);
+}
 void Screen::resetScrolledLines()
 {
     _scrolledLines = 0;
@@ -909,7 +1237,7 @@ void Screen::scrollUp(int from, int n)
     _lastScrolledRegion = QRect(0,_topMargin,columns-1,(_bottomMargin-_topMargin));
 
     //FIXME: make sure `topMargin', `bottomMargin', `from', `n' is in bounds.
-    moveImage(loc(0,from),loc(0,from+n),loc(columns,_bottomMargin));
+    scrollLines(from,_bottomMargin,n);
     clearImage(loc(0,_bottomMargin-n+1),loc(columns-1,_bottomMargin),' ');
 }
 
@@ -930,7 +1258,7 @@ void Screen::scrollDown(int from, int n)
         return;
     if (from + n > _bottomMargin)
         n = _bottomMargin - from;
-    moveImage(loc(0,from+n),loc(0,from),loc(columns-1,_bottomMargin-n));
+    scrollLines(from,_bottomMargin,-n);
     clearImage(loc(0,from),loc(columns-1,from+n-1),' ');
 }
 
@@ -987,6 +1315,7 @@ void Screen::clearImage(int loca, int loce, char c)
 
     int topLine = loca/columns;
     int bottomLine = loce/columns;
+    setLinesDirty(topLine, bottomLine);
 
     Character clearCh(c,currentForeground,currentBackground,DEFAULT_RENDITION);
 
@@ -996,12 +1325,12 @@ void Screen::clearImage(int loca, int loce, char c)
 
     for (int y=topLine;y<=bottomLine;y++)
     {
-        lineProperties[y] = 0;
+        lineProperty(y) = 0;
 
         int endCol = ( y == bottomLine) ? loce%columns : columns-1;
         int startCol = ( y == topLine ) ? loca%columns : 0;
 
-        QVector<Character>& line = screenLines[y];
+        QVector<Character>& line = screenLine(y);
 
         if ( isDefaultCh && endCol == columns-1 )
         {
@@ -1019,37 +1348,43 @@ void Screen::clearImage(int loca, int loce, char c)
     }
 }
 
-void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
+void Screen::scrollLines(int top, int bottom, int n)
 {
-    Q_ASSERT( sourceBegin <= sourceEnd );
-
-    int lines=(sourceEnd-sourceBegin)/columns;
+    const int rotation = n % (bottom - top + 1);
 
-    //move screen image and line properties:
-    //the source and destination areas of the image may overlap,
-    //so it matters that we do the copy in the right order -
-    //forwards if dest < sourceBegin or backwards otherwise.
-    //(search the web for 'memmove implementation' for details)
-    if (dest < sourceBegin)
+    if (rotation == 0)
     {
-        for (int i=0;i<=lines;i++)
-        {
-            screenLines[ (dest/columns)+i ] = screenLines[ (sourceBegin/columns)+i ];
-            lineProperties[(dest/columns)+i]=lineProperties[(sourceBegin/columns)+i];
-        }
+        // all lines of the region scrolled out, nothing to move
+    }
+    else if (top == 0 && bottom == lines - 1)
+    {
+        // the whole screen, only the start of the ring moves
+        _firstLine = ringIndex(rotation > 0 ? rotation : rotation + lines);
     }
     else
     {
-        for (int i=lines;i>=0;i--)
-        {
-            screenLines[ (dest/columns)+i ] = screenLines[ (sourceBegin/columns)+i ];
-            lineProperties[(dest/columns)+i]=lineProperties[(sourceBegin/columns)+i];
-        }
+        // rotate the region by reversing both parts and then all of it,
+        // swapping lines only exchanges their data pointers
+        const auto reverse = [this](int first, int last) {
+            for (; first < last; first++, last--)
+            {
+                const int a = ringIndex(first);
+                const int b = ringIndex(last);
+                screenLines[a].swap(screenLines[b]);
+                std::swap(lineProperties[a], lineProperties[b]);
+            }
+        };
+        const int split = rotation > 0 ? top + rotation : bottom + rotation + 1;
+        reverse(top, split - 1);
+        reverse(split, bottom);
+        reverse(top, bottom);
     }
+    setLinesDirty(top, bottom);
+
+    const int diff = -n * columns; // Scroll by this amount
 
     if (lastPos != -1)
     {
-        int diff = dest - sourceBegin; // Scroll by this amount
         lastPos += diff;
         if ((lastPos < 0) || (lastPos >= (lines*columns)))
             lastPos = -1;
@@ -1059,10 +1394,10 @@ void Screen::moveImage(int dest, int sourceBegin, int sourceEnd)
     if (selBegin != -1)
     {
         bool beginIsTL = (selBegin == selTopLeft);
-        int diff = dest - sourceBegin; // Scroll by this amount
         int scr_TL=loc(0,history->getLines());
-        int srca = sourceBegin+scr_TL; // Translate index from screen to global
-        int srce = sourceEnd+scr_TL; // Translate index from screen to global
+        // the lines which keep their content, translated from screen to global
+        int srca = (n > 0 ? loc(0,top+n) : loc(0,top)) + scr_TL;
+        int srce = (n > 0 ? loc(columns,bottom) : loc(columns-1,bottom+n)) + scr_TL;
         int desta = srca+diff;
         int deste = srce+diff;
 
@@ -1178,6 +1513,21 @@ void Screen::setBackColor(int space, int color)
         setBackColor(COLOR_SPACE_DEFAULT,DEFAULT_BACK_COLOR);
 }
 
+void Screen::getRendition(int& rendition, CharacterColor& foreground, CharacterColor& background) const
+{
+    rendition = currentRendition;
+    foreground = currentForeground;
+    background = currentBackground;
+}
+
+void Screen::setRendition(int rendition, const CharacterColor& foreground, const CharacterColor& background)
+{
+    currentRendition = rendition;
+    currentForeground = foreground.isValid() ? foreground : CharacterColor(COLOR_SPACE_DEFAULT,DEFAULT_FORE_COLOR);
+    currentBackground = background.isValid() ? background : CharacterColor(COLOR_SPACE_DEFAULT,DEFAULT_BACK_COLOR);
+    updateEffectiveRendition();
+}
+
 void Screen::clearSelection()
 {
     selBottomRight = -1;
@@ -1257,6 +1607,19 @@ void Screen::setSelectionEnd( const int x, const int y)
     }
 }
 
+ScreenSelection Screen::selection() const
+{
+    ScreenSelection result;
+    if (isSelectionValid())
+    {
+        result.topLeft = selTopLeft;
+        result.bottomRight = selBottomRight;
+        result.columns = columns;
+        result.columnMode = blockSelectionMode;
+    }
+    return result;
+}
+
 bool Screen::isSelected( const int x,const int y) const
 {
     bool columnInSelection = true;
@@ -1393,10 +1756,10 @@ int Screen::copyLineToStream(int line ,
 
         Q_ASSERT( count >= 0 );
 
-        const int screenLine = line-history->getLines();
+        const int lineOnScreen = line-history->getLines();
 
-        Character* data = screenLines[screenLine].data();
-        int length = screenLines[screenLine].count();
+        Character* data = screenLine(lineOnScreen).data();
+        int length = screenLine(lineOnScreen).count();
 
         //retrieve line from screen image
         for (int i=start;i < qMin(start+count,length);i++)
@@ -1409,8 +1772,8 @@ int Screen::copyLineToStream(int line ,
             return 0;
         count = qBound(0,count,length-start);
 
-        Q_ASSERT( screenLine < lineProperties.count() );
-        currentLineProperties |= lineProperties[screenLine];
+        Q_ASSERT( lineOnScreen < lines );
+        currentLineProperties |= lineProperty(lineOnScreen);
     }
 
     // add new line character at end
@@ -1444,8 +1807,8 @@ void Screen::addHistLine()
     {
         int oldHistLines = history->getLines();
 
-        history->addCellsVector(screenLines[0]);
-        history->addLine( lineProperties[0] & LINE_WRAPPED );
+        history->addCellsVector(screenLine(0));
+        history->addLine( lineProperty(0) & LINE_WRAPPED );
 
         int newHistLines = history->getLines();
 
@@ -1526,9 +1889,10 @@ const HistoryType& Screen::getScroll() const
 void Screen::setLineProperty(LineProperty property , bool enable)
 {
     if ( enable )
-        lineProperties[cuY] = (LineProperty)(lineProperties[cuY] | property);
+        lineProperty(cuY) = (LineProperty)(lineProperty(cuY) | property);
     else
-        lineProperties[cuY] = (LineProperty)(lineProperties[cuY] & ~property);
+        lineProperty(cuY) = (LineProperty)(lineProperty(cuY) & ~property);
+    setLineDirty(cuY);
 }
 void Screen::fillWithDefaultChar(Character* dest, int count)
 {
@@ -24,6 +24,7 @@
 #define SCREEN_H
 
 // Qt
+#include <QBitArray>
 #include <QRect>
 #include <QSet>
 #include <QTextStream>
@@ -32,6 +33,7 @@
 // Konsole
 #include "Character.h"
 #include "History.h"
+#include "qtermwidget_core_export.h"
 
 #define MODE_Origin    0
 #define MODE_Wrap      1
@@ -41,11 +43,59 @@
 #define MODE_NewLine   5
 #define MODES_SCREEN   6
 
+class QDataStream;
+
 namespace Konsole
 {
 
 class TerminalCharacterDecoder;
 
+/**
+ * The selected area of a Screen.  Positions count the lines in the
+ * history first, followed by the lines of the screen, as for
+ * Screen::getImage().
+ */
+struct ScreenSelection
+{
+    int topLeft = -1;     // position of the first selected character
+    int bottomRight = -1; // position of the last selected character
+    int columns = 1;      // the width of the screen the positions refer to
+    bool columnMode = false;
+
+    bool isValid() const
+    { return topLeft >= 0 && bottomRight >= 0; }
+
+    /**
+     * Retrieves the first and last selected column of @p line, returns
+     * false if nothing on the line is selected.
+     */
+    bool selectedColumns(int line, int& startColumn, int& endColumn) const
+    {
+        if (!isValid() || line < topLeft / columns || line > bottomRight / columns)
+            return false;
+
+        if (columnMode)
+        {
+            startColumn = topLeft % columns;
+            endColumn = bottomRight % columns;
+        }
+        else
+        {
+            startColumn = line == topLeft / columns ? topLeft % columns : 0;
+            endColumn = line == bottomRight / columns ? bottomRight % columns : columns - 1;
+        }
+        return true;
+    }
+
+    bool operator==(const ScreenSelection& other) const
+    {
+        return topLeft == other.topLeft && bottomRight == other.bottomRight
+               && columns == other.columns && columnMode == other.columnMode;
+    }
+    bool operator!=(const ScreenSelection& other) const
+    { return !(*this == other); }
+};
+
 /**
     \brief An image of characters with associated attributes.
 
@@ -66,10 +116,10 @@ class TerminalCharacterDecoder;
 
     The screen image has a selection associated with it, specified using
     setSelectionStart() and setSelectionEnd().  The selected text can be retrieved
-    using selectedText().  When getImage() is used to retrieve the visible image,
-    characters which are part of the selection have their colours inverted.
+    using selectedText().  The selection is not part of the image returned by
+    getImage(), views draw selection() on top of it.
 */
-class Screen
+class QTERMWIDGET_CORE_EXPORT Screen
 {
 public:
     /** Construct a new screen image of size @p lines by @p columns. */
@@ -313,6 +363,20 @@ public:
      */
     void setDefaultRendition();
 
+    /**
+     * Returns the rendition flags and colors which are currently applied
+     * to newly displayed characters.
+     */
+    void getRendition(int& rendition, CharacterColor& foreground, CharacterColor& background) const;
+    /**
+     * Replaces the rendition flags and both colors at once.  This is used to
+     * apply all attributes of a select graphic rendition sequence in one go.
+     * Invalid colors are replaced by the default colors.
+     *
+     * @see setRendition, setForeColor, setBackColor
+     */
+    void setRendition(int rendition, const CharacterColor& foreground, const CharacterColor& background);
+
     /** Returns the column which the cursor is positioned at. */
     int  getCursorX() const;
     /** Returns the line which the cursor is positioned on. */
@@ -359,6 +423,32 @@ public:
      */
     void displayCharacter(wchar_t c);
 
+    /**
+     * Displays @p length characters starting at the current cursor position,
+     * with the same result as calling displayCharacter() for each of them.
+     *
+     * Runs of plain single-width characters are written to the current line
+     * as a block, with the current rendition, wrapping only once per line.
+     * Other characters (wide, combining, ...) and insert mode fall back to
+     * displayCharacter().
+     */
+    void displayString(const wchar_t* text, int length);
+
+    /**
+     * Displays @p count complete lines of printable ASCII text, with the
+     * same result as passing each of them to displayString() followed by
+     * a carriage return and a line feed.  Line @p i is made of the
+     * @p lengths[i] characters starting at @p text + @p starts[i].
+     *
+     * While the lines still to come fill at least the whole screen, the
+     * rows they push off the top are appended to the history in a single
+     * batch and only the rows which remain visible are written to the
+     * screen.  This requires the cursor to be at the start of an empty
+     * bottom line, the scrolling region to span the whole screen and no
+     * selection; the remaining lines are displayed one by one.
+     */
+    void displayLines(const wchar_t* text, const int starts[], const int lengths[], int count);
+
     // Do composition with last shown character FIXME: Not implemented yet for KDE 4
     void compose(const QString& compose);
 
@@ -394,6 +484,19 @@ public:
      */
     QVector<LineProperty> getLineProperties( int startLine , int endLine ) const;
 
+    /**
+     * Writes the image, the cursor, the current rendition, the margins,
+     * the modes and the tab stops of the screen to @p stream.  The history
+     * and the selection are not included.
+     */
+    void saveState(QDataStream& stream) const;
+    /**
+     * Restores a state written by saveState(), resizing the image to the
+     * saved size if necessary.  Returns false if the stream does not hold
+     * a valid state, in which case the screen is left partially restored.
+     */
+    bool restoreState(QDataStream& stream);
+
 
     /** Return the number of lines. */
     int getLines() const
@@ -449,6 +552,9 @@ public:
     /** Clears the current selection */
     void clearSelection();
 
+    /** Returns the current selection, which is invalid if nothing is selected */
+    ScreenSelection selection() const;
+
     /**
       *  Returns true if the character at (@p column, @p line) is part of the
       *  current selection.
@@ -555,6 +661,19 @@ public:
      */
     void resetDroppedLines();
 
+    /**
+     * Returns which lines of the screen were written to, erased or
+     * scrolled since the last call to resetDirtyLines().  A change of the
+     * selection marks all lines.
+     */
+    const QBitArray& dirtyLines() const;
+
+    /** Marks all lines of the screen as changed, see dirtyLines() */
+    void setAllLinesDirty();
+
+    /** Resets the changed lines, see dirtyLines() */
+    void resetDirtyLines();
+
     /**
       * Fills the buffer @p dest with @p count instances of the default (ie. blank)
       * Character style.
@@ -582,6 +701,8 @@ private:
     Screen(const Screen &) = delete;
     Screen &operator=(const Screen &) = delete;
 
+    typedef QVector<Character> ImageLine;      // [0..columns]
+
     //copies a line of text from the screen or history into a stream using a
     //specified character decoder.  Returns the number of lines actually copied,
     //which may be less than 'count' if (start+count) is more than the number of characters on
@@ -605,12 +726,29 @@ private:
     //the loc(x,y) macro can be used to generate these values from a column,line pair.
     void clearImage(int loca, int loce, char c);
 
-    //move screen image between 'sourceBegin' and 'sourceEnd' to 'dest'.
-    //the parameters are specified as offsets from the start of the screen image.
-    //the loc(x,y) macro can be used to generate these values from a column,line pair.
-    //
-    //NOTE: moveImage() can only move whole lines
-    void moveImage(int dest, int sourceBegin, int sourceEnd);
+    //moves the lines from 'top' to 'bottom' up by 'n' lines, or down if 'n' is
+    //negative, and adjusts the selection.  the lines moved out at one end of the
+    //region come back in at the other, to be cleared by the caller.
+    void scrollLines(int top, int bottom, int n);
+
+    //the lines of the screen are kept in a ring which starts at _firstLine, so
+    //scrolling the whole screen moves its start instead of the lines.
+    //line 'y' of the screen is stored at screenLines[ringIndex(y)]
+    int ringIndex(int y) const
+    { const int index = _firstLine + y; return index < lines ? index : index - lines; }
+    ImageLine& screenLine(int y)
+    { return screenLines[ringIndex(y)]; }
+    const ImageLine& screenLine(int y) const
+    { return screenLines[ringIndex(y)]; }
+    LineProperty& lineProperty(int y)
+    { return lineProperties[ringIndex(y)]; }
+    LineProperty lineProperty(int y) const
+    { return lineProperties[ringIndex(y)]; }
+    // marks lines as changed, see dirtyLines()
+    void setLineDirty(int y)
+    { _dirtyLines.setBit(y); }
+    void setLinesDirty(int top, int bottom)
+    { _dirtyLines.fill(true, top, bottom + 1); }
     // scroll up 'i' lines in current region, clearing the bottom 'i' lines
     void scrollUp(int from, int i);
     // scroll down 'i' lines in current region, clearing the top 'i' lines
@@ -635,19 +773,29 @@ private:
     // starting from 'startLine', where 0 is the first line in the history
     void copyFromHistory(Character* dest, int startLine, int count) const;
 
+    // true if displayLines() may move rows straight to the history, see there
+    bool canBatchLines() const;
+    // displays the lines given to displayLines(), which produce 'rows' rows
+    // on the screen, by appending all rows but the last 'lines' ones to the
+    // history in one call
+    void batchLines(const wchar_t* text, const int starts[], const int lengths[],
+                    int count, int rows);
+
 
     // screen image ----------------
     int lines;
     int columns;
 
-    typedef QVector<Character> ImageLine;      // [0..columns]
-    ImageLine*          screenLines;    // [lines]
+    ImageLine*          screenLines;    // [lines], in ring order, see ringIndex()
+    int                 _firstLine;     // index of the top line in screenLines
 
     int _scrolledLines;
     QRect _lastScrolledRegion;
 
     int _droppedLines;
 
+    QBitArray _dirtyLines; // see dirtyLines()
+
     QVarLengthArray<LineProperty,64> lineProperties;
 
     // history buffer ---------------
@@ -660,7 +808,7 @@ private:
     // cursor color and rendition info
     CharacterColor currentForeground;
     CharacterColor currentBackground;
-    quint8 currentRendition;
+    quint16 currentRendition;
 
     // margins ----------------
     int _topMargin;
@@ -683,7 +831,7 @@ private:
     // effective colors and rendition ------------
     CharacterColor effectiveForeground; // These are derived from
     CharacterColor effectiveBackground; // the cu_* variables above
-    quint8 effectiveRendition;          // to speed up operation
+    quint16 effectiveRendition;         // to speed up operation
 
     class SavedState
     {
@@ -693,7 +841,7 @@ private:
 
         int cursorColumn;
         int cursorLine;
-        quint8 rendition;
+        quint16 rendition;
         CharacterColor foreground;
         CharacterColor background;
     };
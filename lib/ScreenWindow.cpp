@@ -23,32 +23,100 @@
 // Qt
 #include <QtDebug>
 
+// Standard Library
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
 // Konsole
 #include "Screen.h"
 
 using namespace Konsole;
 
+void ScreenSnapshotBuffer::publish()
+{
+    QMutexLocker locker(&_mutex);
+    _back.serial = _front.serial + 1;
+    std::swap(_front, _back);
+}
+
+void ScreenSnapshotBuffer::take(ScreenSnapshot& snapshot) const
+{
+    // the vectors are implicitly shared, the emulation thread detaches
+    // from them when it fills the back buffer again
+    QMutexLocker locker(&_mutex);
+    snapshot = _front;
+}
+
+void ScreenFrameCache::advance()
+{
+    _serial++;
+}
+
+void ScreenFrameCache::clear()
+{
+    _frames.clear();
+}
+
+std::shared_ptr<ScreenFrame> ScreenFrameCache::find(const Screen* screen, quint64 serial,
+                                                    int firstLine, int lines, int columns) const
+{
+    for (const std::weak_ptr<ScreenFrame>& entry : _frames)
+    {
+        std::shared_ptr<ScreenFrame> frame = entry.lock();
+        if (frame && frame->screen == screen && frame->serial == serial
+            && frame->firstLine == firstLine && frame->lines == lines
+            && frame->columns == columns)
+            return frame;
+    }
+    return nullptr;
+}
+
+void ScreenFrameCache::insert(const std::shared_ptr<ScreenFrame>& frame)
+{
+    // frames are updated in place, so they only need to be added once
+    _frames.erase(std::remove_if(_frames.begin(), _frames.end(),
+                                 [](const std::weak_ptr<ScreenFrame>& entry) {
+                                     return entry.expired();
+                                 }),
+                  _frames.end());
+    for (const std::weak_ptr<ScreenFrame>& entry : std::as_const(_frames))
+    {
+        if (entry.lock() == frame)
+            return;
+    }
+    _frames << frame;
+}
+
+// views compare the generations of frames copied by different windows,
+// so they are counted for all windows
+static quint64 nextLineGeneration()
+{
+    static std::atomic<quint64> generation(0);
+    return ++generation;
+}
+
 ScreenWindow::ScreenWindow(QObject* parent)
     : QObject(parent)
     , _screen(nullptr)
-    , _windowBuffer(nullptr)
-    , _windowBufferSize(0)
     , _bufferNeedsUpdate(true)
+    , _frameCache(nullptr)
     , _windowLines(1)
     , _currentLine(0)
     , _trackOutput(true)
     , _scrollCount(0)
+    , _suspended(false)
+    , _snapshots(nullptr)
+    , _screenLock(nullptr)
 {
 }
-ScreenWindow::~ScreenWindow()
-{
-    delete[] _windowBuffer;
-}
+ScreenWindow::~ScreenWindow() = default;
 void ScreenWindow::setScreen(Screen* screen)
 {
     Q_ASSERT( screen );
 
     _screen = screen;
+    _bufferNeedsUpdate = true;
 }
 
 Screen* ScreenWindow::screen() const
@@ -56,42 +124,285 @@ Screen* ScreenWindow::screen() const
     return _screen;
 }
 
-Character* ScreenWindow::getImage()
+void ScreenWindow::setSnapshotSource(const ScreenSnapshotBuffer* snapshots, QRecursiveMutex* screenLock)
 {
-    // reallocate internal buffer if the window size has changed
-    int size = windowLines() * windowColumns();
-    if (_windowBuffer == nullptr || _windowBufferSize != size)
-    {
-        delete[] _windowBuffer;
-        _windowBufferSize = size;
-        _windowBuffer = new Character[size];
+    _snapshots = snapshots;
+    _screenLock = screenLock;
+
+    if (_snapshots)
+        _snapshots->take(_snapshot);
+    else
+        _snapshot = ScreenSnapshot();
+
+    _bufferNeedsUpdate = true;
+}
+
+void ScreenWindow::setFrameCache(ScreenFrameCache* cache)
+{
+    _frameCache = cache;
+}
+
+const Character* ScreenWindow::getImage()
+{
+    updateFrame();
+    return _frame->image.constData();
+}
+
+std::shared_ptr<const ScreenFrame> ScreenWindow::frame()
+{
+    updateFrame();
+    return _frame;
+}
+
+quint64 ScreenWindow::frameSerial() const
+{
+    if (_snapshots)
+        return _snapshot.serial;
+
+    return _frameCache ? _frameCache->serial() : 0;
+}
+
+void ScreenWindow::updateFrame()
+{
+    const int lines = windowLines();
+    const int columns = windowColumns();
+    if (!_frame || _frame->lines != lines || _frame->columns != columns)
         _bufferNeedsUpdate = true;
+
+    const quint64 serial = frameSerial();
+    const bool changed = _bufferNeedsUpdate || _changedLines.count(true) > 0;
+    if (!changed)
+    {
+        // the frame still shows the screen as it is now
+        _frame->serial = serial;
+        return;
     }
 
-     if (!_bufferNeedsUpdate)
-        return _windowBuffer;
+    // another window may have copied the same lines already
+    if (_frameCache)
+    {
+        std::shared_ptr<ScreenFrame> frame = _frameCache->find(_screen, serial, currentLine(),
+                                                               lines, columns);
+        if (frame && frame != _frame)
+        {
+            _frame = std::move(frame);
+            _changedLines.fill(false, lines);
+            _bufferNeedsUpdate = false;
+            return;
+        }
+    }
 
-    _screen->getImage(_windowBuffer,size,
-                      currentLine(),endWindowLine());
+    if (_bufferNeedsUpdate)
+        copyFrame(serial);
+    else
+        copyChangedLines(serial);
 
-    // this window may look beyond the end of the screen, in which
-    // case there will be an unused area which needs to be filled
-    // with blank characters
-    fillUnusedArea();
+    if (_frameCache)
+        _frameCache->insert(_frame);
+}
 
+void ScreenWindow::copyFrame(quint64 serial)
+{
+    // views may still hold on to the frame
+    if (!_frame || _frame.use_count() > 1)
+        _frame = std::make_shared<ScreenFrame>();
+
+    ScreenFrame& frame = *_frame;
+    frame.lines = windowLines();
+    frame.columns = windowColumns();
+    const int size = frame.lines * frame.columns;
+    frame.image.resize(size);
+
+    if (_snapshots)
+    {
+        copySnapshotImage(frame.image.data(), size);
+        frame.lineProperties = snapshotLineProperties();
+    }
+    else
+    {
+        _screen->getImage(frame.image.data(),size,
+                          currentLine(),endWindowLine());
+
+        // this window may look beyond the end of the screen, in which
+        // case there will be an unused area which needs to be filled
+        // with blank characters
+        fillUnusedArea(frame.image.data(), size);
+
+        frame.lineProperties = _screen->getLineProperties(currentLine(),endWindowLine());
+    }
+    frame.lineProperties.resize(frame.lines);
+    frame.lineGenerations.fill(nextLineGeneration(), frame.lines);
+
+    frame.firstLine = currentLine();
+    frame.lineCount = lineCount();
+    frame.histLines = screenHistLines();
+    frame.cursorLine = cursorWindowLine();
+    frame.screen = _screen;
+    frame.serial = serial;
+
+    _changedLines.fill(false, frame.lines);
     _bufferNeedsUpdate = false;
-    return _windowBuffer;
 }
 
-void ScreenWindow::fillUnusedArea()
+int ScreenWindow::screenHistLines() const
+{
+    return _snapshots ? _snapshot.histLines : _screen->getHistLines();
+}
+
+int ScreenWindow::cursorWindowLine() const
+{
+    return screenHistLines() + cursorPosition().y() - currentLine();
+}
+
+void ScreenWindow::markChangedLines(const QBitArray& screenLines, int histLines)
 {
-    int screenEndLine = _screen->getHistLines() + _screen->getLines() - 1;
+    const int firstLine = currentLine();
+    const int lines = windowLines();
+    if (_bufferNeedsUpdate || !_frame || firstLine != _frame->firstLine
+        || histLines < _frame->histLines)
+    {
+        _bufferNeedsUpdate = true;
+        return;
+    }
+
+    // the window shows lines past the end of the output, which moved
+    if (lineCount() != _frame->lineCount && firstLine + lines > qMin(lineCount(), _frame->lineCount))
+    {
+        _bufferNeedsUpdate = true;
+        return;
+    }
+
+    // lines which were in the history when the frame was copied did not
+    // change, while the window is scrolled back they usually are all of it
+    const int firstChangedLine = qMax(0, _frame->histLines - firstLine);
+    const int firstScreenLine = qMax(0, histLines - firstLine);
+
+    // snapshots only hold the lines of the screen
+    if (_snapshots && firstChangedLine < qMin(firstScreenLine, lines))
+    {
+        _bufferNeedsUpdate = true;
+        return;
+    }
+
+    // lines which moved from the screen into the history since
+    for (int line = firstChangedLine; line < qMin(firstScreenLine, lines); line++)
+        _changedLines.setBit(line);
+
+    // lines still on the screen, all of them if the changes are not known
+    const bool allChanged = screenLines.size() != lineCount() - histLines;
+    const int offset = firstLine - histLines;
+    const int count = qMin(lines, lineCount() - firstLine);
+    for (int line = qMax(firstChangedLine, firstScreenLine); line < count; line++)
+    {
+        if (allChanged || screenLines.testBit(offset + line))
+            _changedLines.setBit(line);
+    }
+
+    // the cursor is part of the image, so the lines it left and
+    // entered changed too
+    const int cursorLine = cursorWindowLine();
+    if (_frame->cursorLine >= 0 && _frame->cursorLine < count)
+        _changedLines.setBit(_frame->cursorLine);
+    if (cursorLine >= 0 && cursorLine < count)
+        _changedLines.setBit(cursorLine);
+}
+
+void ScreenWindow::copyChangedLines(quint64 serial)
+{
+    // the frame is shared with another window or a view, which still
+    // show the previous content
+    if (_frame.use_count() > 1)
+        _frame = std::make_shared<ScreenFrame>(*_frame);
+
+    ScreenFrame& frame = *_frame;
+    const int columns = frame.columns;
+    const int firstLine = currentLine();
+    const int lines = _changedLines.size();
+    const quint64 generation = nextLineGeneration();
+
+    Character* const image = frame.image.data();
+    LineProperty* const lineProperties = frame.lineProperties.data();
+    quint64* const lineGenerations = frame.lineGenerations.data();
+
+    for (int line = 0; line < lines; line++)
+    {
+        if (!_changedLines.testBit(line))
+            continue;
+
+        // copy runs of changed lines at once
+        int last = line;
+        while (last + 1 < lines && _changedLines.testBit(last + 1))
+            last++;
+
+        Character* dest = image + line * columns;
+        const int count = (last - line + 1) * columns;
+        if (_snapshots)
+        {
+            const int screenLine = firstLine - _snapshot.histLines + line;
+            std::copy_n(_snapshot.image.constData() + screenLine * columns, count, dest);
+            std::copy_n(_snapshot.lineProperties.constData() + screenLine, last - line + 1,
+                        lineProperties + line);
+        }
+        else
+        {
+            _screen->getImage(dest, count, firstLine + line, firstLine + last);
+            const QVector<LineProperty> properties =
+                    _screen->getLineProperties(firstLine + line, firstLine + last);
+            std::copy(properties.cbegin(), properties.cend(), lineProperties + line);
+        }
+        std::fill(lineGenerations + line, lineGenerations + last + 1, generation);
+
+        line = last;
+    }
+
+    _changedLines.fill(false);
+    frame.lineCount = lineCount();
+    frame.histLines = screenHistLines();
+    frame.cursorLine = cursorWindowLine();
+    frame.serial = serial;
+}
+
+void ScreenWindow::copySnapshotImage(Character* dest, int size)
+{
+    const int columns = _snapshot.columns;
+    const int firstScreenLine = currentLine() - _snapshot.histLines;
+    int copiedLines = 0;
+
+    if (firstScreenLine >= 0)
+    {
+        // the snapshot holds all lines of the screen itself
+        copiedLines = qBound(0, _snapshot.lines - firstScreenLine, windowLines());
+        std::copy_n(_snapshot.image.constData() + firstScreenLine * columns,
+                    copiedLines * columns, dest);
+    }
+    else
+    {
+        // lines in the history are only held by the screen, which may
+        // already have been resized since the snapshot was taken
+        QMutexLocker locker(_screenLock);
+        if (_screen->getColumns() == columns)
+        {
+            const int endLine = qMin(currentLine() + windowLines(),
+                                     _screen->getHistLines() + _screen->getLines()) - 1;
+            copiedLines = qMax(0, endLine - currentLine() + 1);
+            if (copiedLines > 0)
+                _screen->getImage(dest, size, currentLine(), endLine);
+        }
+    }
+
+    Screen::fillWithDefaultChar(dest + copiedLines * columns,
+                                size - copiedLines * columns);
+}
+
+void ScreenWindow::fillUnusedArea(Character* dest, int size)
+{
+    int screenEndLine = lineCount() - 1;
     int windowEndLine = currentLine() + windowLines() - 1;
 
     int unusedLines = windowEndLine - screenEndLine;
     int charsToFill = unusedLines * windowColumns();
 
-    Screen::fillWithDefaultChar(_windowBuffer + _windowBufferSize - charsToFill,charsToFill);
+    Screen::fillWithDefaultChar(dest + size - charsToFill,charsToFill);
 }
 
 // return the index of the line at the end of this window, or if this window
@@ -108,53 +419,79 @@ int ScreenWindow::endWindowLine() const
 }
 QVector<LineProperty> ScreenWindow::getLineProperties()
 {
-    QVector<LineProperty> result = _screen->getLineProperties(currentLine(),endWindowLine());
+    // shares the vector of the frame
+    updateFrame();
+    return _frame->lineProperties;
+}
+
+QVector<LineProperty> ScreenWindow::snapshotLineProperties()
+{
+    const int firstScreenLine = currentLine() - _snapshot.histLines;
 
-    if (result.count() != windowLines())
-        result.resize(windowLines());
+    if (firstScreenLine >= 0)
+        return _snapshot.lineProperties.mid(firstScreenLine, windowLines());
 
-    return result;
+    QMutexLocker locker(_screenLock);
+    const int endLine = qMin(currentLine() + windowLines(),
+                             _screen->getHistLines() + _screen->getLines()) - 1;
+    if (endLine < currentLine())
+        return QVector<LineProperty>();
+    return _screen->getLineProperties(currentLine(), endLine);
 }
 
 QString ScreenWindow::selectedText( bool preserveLineBreaks ) const
 {
+    QMutexLocker locker(_screenLock);
     return _screen->selectedText( preserveLineBreaks );
 }
 
 void ScreenWindow::getSelectionStart( int& column , int& line )
 {
+    QMutexLocker locker(_screenLock);
     _screen->getSelectionStart(column,line);
     line -= currentLine();
 }
 void ScreenWindow::getSelectionEnd( int& column , int& line )
 {
+    QMutexLocker locker(_screenLock);
     _screen->getSelectionEnd(column,line);
     line -= currentLine();
 }
 void ScreenWindow::setSelectionStart( int column , int line , bool columnMode )
 {
+    QMutexLocker locker(_screenLock);
     _screen->setSelectionStart( column , qMin(line + currentLine(),endWindowLine())  , columnMode);
+    locker.unlock();
 
-    _bufferNeedsUpdate = true;
     emit selectionChanged();
 }
 
 void ScreenWindow::setSelectionEnd( int column , int line )
 {
+    QMutexLocker locker(_screenLock);
     _screen->setSelectionEnd( column , qMin(line + currentLine(),endWindowLine()) );
+    locker.unlock();
 
-    _bufferNeedsUpdate = true;
     emit selectionChanged();
 }
 
 bool ScreenWindow::isSelected( int column , int line )
 {
+    QMutexLocker locker(_screenLock);
     return _screen->isSelected( column , qMin(line + currentLine(),endWindowLine()) );
 }
 
+ScreenSelection ScreenWindow::selection() const
+{
+    QMutexLocker locker(_screenLock);
+    return _screen->selection();
+}
+
 void ScreenWindow::clearSelection()
 {
+    QMutexLocker locker(_screenLock);
     _screen->clearSelection();
+    locker.unlock();
 
     emit selectionChanged();
 }
@@ -162,6 +499,8 @@ void ScreenWindow::clearSelection()
 void ScreenWindow::setWindowLines(int lines)
 {
     Q_ASSERT(lines > 0);
+    if (lines != _windowLines)
+        _bufferNeedsUpdate = true;
     _windowLines = lines;
 }
 int ScreenWindow::windowLines() const
@@ -171,21 +510,30 @@ int ScreenWindow::windowLines() const
 
 int ScreenWindow::windowColumns() const
 {
-    return _screen->getColumns();
+    return columnCount();
 }
 
 int ScreenWindow::lineCount() const
 {
+    if (_snapshots)
+        return _snapshot.histLines + _snapshot.lines;
+
     return _screen->getHistLines() + _screen->getLines();
 }
 
 int ScreenWindow::columnCount() const
 {
+    if (_snapshots)
+        return _snapshot.columns;
+
     return _screen->getColumns();
 }
 
 QPoint ScreenWindow::cursorPosition() const
 {
+    if (_snapshots)
+        return _snapshot.cursor;
+
     QPoint position;
 
     position.setX( _screen->getCursorX() );
@@ -243,6 +591,23 @@ bool ScreenWindow::trackOutput() const
     return _trackOutput;
 }
 
+void ScreenWindow::setSuspended(bool suspended)
+{
+    if (suspended == _suspended)
+        return;
+
+    _suspended = suspended;
+    if (!suspended)
+        _scrollCount = 0;
+
+    emit suspendedChanged(suspended);
+}
+
+bool ScreenWindow::isSuspended() const
+{
+    return _suspended;
+}
+
 int ScreenWindow::scrollCount() const
 {
     return _scrollCount;
@@ -255,22 +620,64 @@ void ScreenWindow::resetScrollCount()
 
 QRect ScreenWindow::scrollRegion() const
 {
-    bool equalToScreenSize = windowLines() == _screen->getLines();
+    const int screenLines = _snapshots ? _snapshot.lines : _screen->getLines();
+    bool equalToScreenSize = windowLines() == screenLines;
 
     if ( atEndOfOutput() && equalToScreenSize )
-        return _screen->lastScrolledRegion();
+        return _snapshots ? _snapshot.lastScrolledRegion : _screen->lastScrolledRegion();
     else
         return {0,0,windowColumns(),windowLines()};
 }
 
 void ScreenWindow::notifyOutputChanged()
 {
+    int scrolledLines;
+    int droppedLines;
+    int histLines;
+    int screenLines;
+    QBitArray changedLines; // the lines of the screen, unknown if empty
+
+    // the snapshot taken after resuming covers the updates skipped here
+    if (_suspended && _snapshots)
+        return;
+
+    if (_snapshots)
+    {
+        // the counts in the snapshot are totals, see ScreenSnapshot
+        const qint64 previousScrolledLines = _snapshot.scrolledLines;
+        const qint64 previousDroppedLines = _snapshot.droppedLines;
+        const quint64 previousSerial = _snapshot.serial;
+        _snapshots->take(_snapshot);
+
+        // the changed lines are only known if the window saw the
+        // previous snapshot
+        if (_snapshot.serial == previousSerial)
+            changedLines.fill(false, _snapshot.lines);
+        else if (_snapshot.serial == previousSerial + 1)
+            changedLines = _snapshot.dirtyLines;
+
+        scrolledLines = int(_snapshot.scrolledLines - previousScrolledLines);
+        droppedLines = int(_snapshot.droppedLines - previousDroppedLines);
+        histLines = _snapshot.histLines;
+        screenLines = _snapshot.lines;
+    }
+    else
+    {
+        scrolledLines = _screen->scrolledLines();
+        droppedLines = _screen->droppedLines();
+        histLines = _screen->getHistLines();
+        screenLines = _screen->getLines();
+        changedLines = _screen->dirtyLines();
+    }
+
+    const int previousLine = _currentLine;
+
     // move window to the bottom of the screen and update scroll count
     // if this window is currently tracking the bottom of the screen
     if ( _trackOutput )
     {
-        _scrollCount -= _screen->scrolledLines();
-        _currentLine = qMax(0,_screen->getHistLines() - (windowLines()-_screen->getLines()));
+        _scrollCount -= scrolledLines;
+        _currentLine = qMax(0,histLines - (windowLines()-screenLines));
     }
     else
     {
@@ -279,15 +686,23 @@ void ScreenWindow::notifyOutputChanged()
         // lines of output - in this case the screen
         // window's current line number will need to
         // be adjusted - otherwise the output will scroll
-        _currentLine = qMax(0,_currentLine -
-                              _screen->droppedLines());
+        _currentLine = qMax(0,_currentLine - droppedLines);
 
         // ensure that the screen window's current position does
         // not go beyond the bottom of the screen
-        _currentLine = qMin( _currentLine , _screen->getHistLines() );
+        _currentLine = qMin( _currentLine , histLines );
     }
 
-    _bufferNeedsUpdate = true;
+    // while the window is scrolled back, output only changes what it
+    // shows if it reaches the visible lines or drops lines from the history
+    if (droppedLines != 0 || _currentLine != previousLine
+        || (_trackOutput && scrolledLines != 0))
+        _bufferNeedsUpdate = true;
+    else
+        markChangedLines(changedLines, histLines);
+
+    if (_suspended)
+        return;
 
     emit outputChanged();
 }
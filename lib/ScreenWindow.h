@@ -21,18 +21,134 @@
 #define SCREENWINDOW_H
 
 // Qt
+#include <QBitArray>
+#include <QMutex>
 #include <QObject>
 #include <QPoint>
 #include <QRect>
+#include <QRecursiveMutex>
+#include <QVector>
+
+// Standard Library
+#include <memory>
 
 // Konsole
 #include "Character.h"
 #include "KeyboardTranslator.h"
+#include "qtermwidget_core_export.h"
 
 namespace Konsole
 {
 
 class Screen;
+struct ScreenSelection;
+
+/**
+ * A copy of the visible part of a screen, taken at the end of a frame by an
+ * emulation which runs on a worker thread.  See Session::setThreadedEmulation()
+ */
+struct ScreenSnapshot
+{
+    /** lines * columns characters, with the cursor applied */
+    QVector<Character> image;
+    QVector<LineProperty> lineProperties;
+    int lines = 0;
+    int columns = 0;
+    int histLines = 0;
+    QPoint cursor;
+    QRect lastScrolledRegion;
+    /**
+     * Running totals of the lines scrolled and dropped from the history,
+     * windows compare them with the totals of the previous snapshot they saw.
+     */
+    qint64 scrolledLines = 0;
+    qint64 droppedLines = 0;
+    /** The lines of the screen which changed since the previous snapshot */
+    QBitArray dirtyLines;
+    /** Counts the published snapshots, so windows notice when they missed one */
+    quint64 serial = 0;
+};
+
+/**
+ * Double buffered ScreenSnapshot.  The emulation thread fills back() and
+ * publish()es it, windows copy the latest published snapshot with take().
+ */
+class ScreenSnapshotBuffer
+{
+public:
+    /** The snapshot being prepared, only to be used by the emulation thread. */
+    ScreenSnapshot& back() { return _back; }
+    /** Makes the snapshot prepared in back() the current one. */
+    void publish();
+    /** Copies the current snapshot to @p snapshot. */
+    void take(ScreenSnapshot& snapshot) const;
+
+private:
+    mutable QMutex _mutex;
+    ScreenSnapshot _front;
+    ScreenSnapshot _back;
+};
+
+/**
+ * The characters shown by a ScreenWindow.  Windows of an emulation which
+ * show the same lines share one frame, and views keep a reference to it
+ * instead of copying the characters.
+ */
+struct ScreenFrame
+{
+    int lines = 0;
+    int columns = 0;
+    /** The first line shown, see ScreenWindow::currentLine() */
+    int firstLine = 0;
+    /** The number of lines of the screen and its history when the frame was copied */
+    int lineCount = 0;
+    /** The number of lines in the history when the frame was copied */
+    int histLines = 0;
+    /** The line of the frame showing the cursor */
+    int cursorLine = -1;
+    const Screen* screen = nullptr;
+    /** The update the frame is current for, see ScreenFrameCache */
+    quint64 serial = 0;
+
+    /** lines * columns characters, with the cursor applied */
+    QVector<Character> image;
+    QVector<LineProperty> lineProperties;
+    /**
+     * Changes whenever a line is copied again.  Lines with the same
+     * generation in two frames hold the same characters, so views only
+     * need to compare lines whose generation changed.
+     */
+    QVector<quint64> lineGenerations;
+};
+
+/**
+ * Looks up the frames of the windows of an emulation, so that windows
+ * showing the same lines of a screen share one frame instead of each
+ * copying it.  Only weak references are kept, a frame used by a single
+ * window is updated in place.
+ */
+class ScreenFrameCache
+{
+public:
+    /**
+     * Starts a new update of the screens, frames are only shared between
+     * windows while their serial is the same.
+     */
+    void advance();
+    /** Forgets all frames */
+    void clear();
+    quint64 serial() const { return _serial; }
+
+    /** Returns a frame current for @p serial showing the given lines, or nullptr */
+    std::shared_ptr<ScreenFrame> find(const Screen* screen, quint64 serial,
+                                      int firstLine, int lines, int columns) const;
+    /** Makes @p frame available to find() */
+    void insert(const std::shared_ptr<ScreenFrame>& frame);
+
+private:
+    quint64 _serial = 0;
+    QVector<std::weak_ptr<ScreenFrame>> _frames;
+};
 
 /**
  * Provides a window onto a section of a terminal screen.  A terminal widget can then render
@@ -51,7 +167,7 @@ class Screen;
  * be called.  This in turn will update the window's position and emit the outputChanged() signal
  * if necessary.
  */
-class ScreenWindow : public QObject
+class QTERMWIDGET_CORE_EXPORT ScreenWindow : public QObject
 {
 Q_OBJECT
 
@@ -73,14 +189,29 @@ public:
     /** Returns the screen which this window looks onto */
     Screen* screen() const;
 
+    /**
+     * Makes the window display the snapshots published to @p snapshots
+     * instead of reading the screen directly, and take @p screenLock
+     * when it has to access the screen, e.g. for the selection or for
+     * lines in the history.  Used while the emulation runs on a worker
+     * thread, passing nullptr for both returns to reading the screen.
+     */
+    void setSnapshotSource(const ScreenSnapshotBuffer* snapshots, QRecursiveMutex* screenLock);
+
+    /**
+     * Shares the frames of this window with the other windows using
+     * @p cache, see ScreenFrameCache.
+     */
+    void setFrameCache(ScreenFrameCache* cache);
+
     /**
      * Returns the image of characters which are currently visible through this window
      * onto the screen.
      *
      * The returned buffer is managed by the ScreenWindow instance and does not need to be
-     * deleted by the caller.
+     * deleted by the caller.  It is valid until the window is updated again.
      */
-    Character* getImage();
+    const Character* getImage();
 
     /**
      * Returns the line attributes associated with the lines of characters which
@@ -88,6 +219,16 @@ public:
      */
     QVector<LineProperty> getLineProperties();
 
+    /**
+     * Returns the frame holding the image and line properties which are
+     * currently visible through this window.
+     *
+     * Unless the output scrolled or the window moved, only the lines of the
+     * screen which changed are copied into the frame, and only they get a new
+     * ScreenFrame::lineGenerations entry.
+     */
+    std::shared_ptr<const ScreenFrame> frame();
+
     /**
      * Returns the number of lines which the region of the window
      * specified by scrollRegion() has been scrolled by since the last call
@@ -137,6 +278,12 @@ public:
      * Returns true if the character at @p line , @p column is part of the selection.
      */
     bool isSelected( int column , int line );
+    /**
+     * Returns the selection, which the image returned by getImage() does not
+     * include.  Its lines are those of the screen, the first line of the
+     * window is currentLine().
+     */
+    ScreenSelection selection() const;
     /**
      * Clears the current selection
      */
@@ -216,6 +363,18 @@ public:
      */
     QString selectedText( bool preserveLineBreaks ) const;
 
+    /**
+     * Suspends or resumes updates of the window, e.g. while the view showing
+     * it is hidden.  A suspended window keeps its position but does not
+     * copy the screen or emit outputChanged().  When every window of an
+     * emulation is suspended, the emulation stops updating its windows
+     * altogether, and resuming one brings it up to date with a single
+     * update.
+     */
+    void setSuspended(bool suspended);
+    /** Returns whether updates of the window are suspended.  See setSuspended() */
+    bool isSuspended() const;
+
 public slots:
     /**
      * Notifies the window that the contents of the associated terminal screen have changed.
@@ -244,20 +403,47 @@ signals:
 
     void scrollToEnd();
 
+    /** Emitted when the window is suspended or resumed.  See setSuspended() */
+    void suspendedChanged(bool suspended);
+
 private:
     int endWindowLine() const;
-    void fillUnusedArea();
+    void fillUnusedArea(Character* dest, int size);
+    // brings _frame up to date, see frame()
+    void updateFrame();
+    // copies all lines of the window into _frame
+    void copyFrame(quint64 serial);
+    // the full copy while showing snapshots
+    void copySnapshotImage(Character* dest, int size);
+    QVector<LineProperty> snapshotLineProperties();
+    // marks the lines of the window which show the changed 'screenLines',
+    // or the whole window if it does not show the same lines any more
+    void markChangedLines(const QBitArray& screenLines, int histLines);
+    // copies the lines marked by markChangedLines() into _frame
+    void copyChangedLines(quint64 serial);
+    // the window line showing the cursor
+    int cursorWindowLine() const;
+    // the number of lines in the history of the screen or snapshot
+    int screenHistLines() const;
+    // the serial of the update the screen or snapshot is at, see ScreenFrameCache
+    quint64 frameSerial() const;
 
     Screen* _screen; // see setScreen() , screen()
-    Character* _windowBuffer;
-    int _windowBufferSize;
+    std::shared_ptr<ScreenFrame> _frame; // see frame()
     bool _bufferNeedsUpdate;
+    QBitArray _changedLines; // lines of the frame to copy again, see markChangedLines()
+    ScreenFrameCache* _frameCache; // see setFrameCache()
 
     int  _windowLines;
     int  _currentLine; // see scrollTo() , currentLine()
     bool _trackOutput; // see setTrackOutput() , trackOutput()
     int  _scrollCount; // count of lines which the window has been scrolled by since
                        // the last call to resetScrollCount()
+    bool _suspended;   // see setSuspended()
+
+    const ScreenSnapshotBuffer* _snapshots; // see setSnapshotSource()
+    QRecursiveMutex* _screenLock;
+    ScreenSnapshot _snapshot; // the snapshot currently shown
 };
 
 }
@@ -27,6 +27,7 @@
 
 // Standard
 #include <cstdlib>
+#include <memory>
 
 // Qt
 #include <QApplication>
@@ -35,7 +36,9 @@
 #include <QStringList>
 #include <QFile>
 #include <QtDebug>
+#include <QMetaMethod>
 #include <QRegularExpression>
+#include <QScreen>
 #include <QThread>
 
 #include "Pty.h"
@@ -70,6 +73,9 @@ Session::Session(QObject* parent) :
 //   , _zmodemBusy(false)
 //   , _zmodemProc(0)
 //   , _zmodemProgress(0)
+        , _emulationThread(nullptr)
+        , _pendingEmulationBytes(0)
+        , _emulationBacklogged(false)
         , _hasDarkBackground(false)
 {
     //prepare DBus communication
@@ -112,8 +118,10 @@ Session::Session(QObject* parent) :
     // connect the I/O between emulator and pty process
     connect( _shellProcess,SIGNAL(receivedData(const char *,int)),this,
              SLOT(onReceiveBlock(const char *,int)) );
-    connect( _emulation,SIGNAL(sendData(const char *,int)),_shellProcess,
-             SLOT(sendData(const char *,int)) );
+    // direct, so the data is passed on before the emulation's thread
+    // reuses the buffer, see onEmulationSendData()
+    connect( _emulation, &Emulation::sendData, this, &Session::onEmulationSendData,
+             Qt::DirectConnection );
     connect( _emulation,SIGNAL(lockPtyRequest(bool)),_shellProcess,SLOT(lockPty(bool)) );
     connect( _emulation,SIGNAL(useUtf8Request(bool)),_shellProcess,SLOT(setUtf8Mode(bool)) );
 
@@ -181,12 +189,12 @@ void Session::addView(TerminalDisplay * widget)
 
     if ( _emulation != nullptr ) {
         // connect emulation - view signals and slots
-        connect( widget , &TerminalDisplay::keyPressedSignal, _emulation ,
-                 &Emulation::sendKeyEvent);
+        connect( widget , &TerminalDisplay::keyPressedSignal, this ,
+                 &Session::onViewKeyPressed);
         connect( widget , SIGNAL(mouseSignal(int,int,int,int)) , _emulation ,
                  SLOT(sendMouseEvent(int,int,int,int)) );
-        connect( widget , SIGNAL(sendStringToEmu(const char *)) , _emulation ,
-                 SLOT(sendString(const char *)) );
+        connect( widget , SIGNAL(sendStringToEmu(const char *)) , this ,
+                 SLOT(onViewSendString(const char *)) );
 
         // allow emulation to notify view when the foreground process
         // indicates whether or not it is interested in mouse signals
@@ -201,6 +209,10 @@ void Session::addView(TerminalDisplay * widget)
         widget->setBracketedPasteMode(_emulation->programBracketedPasteMode());
 
         widget->setScreenWindow(_emulation->createWindow());
+
+        // align the updates to the screen the view is shown on
+        if (QScreen* screen = widget->screen())
+            _emulation->setRefreshRate(screen->refreshRate());
     }
 
     //connect view signals and slots
@@ -351,8 +363,7 @@ void Session::runEmptyPTY()
     _shellProcess->setWriteable(false);
 
     // disconnect send data from emulator to internal terminal process
-    disconnect( _emulation,SIGNAL(sendData(const char *,int)),
-                _shellProcess, SLOT(sendData(const char *,int)) );
+    disconnect( _emulation, &Emulation::sendData, this, &Session::onEmulationSendData );
 
     _shellProcess->setEmptyPTYProperties();
     emit started();
@@ -538,7 +549,9 @@ void Session::updateTerminalSize()
 
     // backend emulation must have a _terminal of at least 1 column x 1 line in size
     if ( minLines > 0 && minColumns > 0 ) {
-        _emulation->setImageSize( minLines , minColumns );
+        runInEmulation([this, minLines, minColumns] {
+            _emulation->setImageSize( minLines , minColumns );
+        });
         _shellProcess->setWindowSize( minLines , minColumns );
     }
 }
@@ -650,17 +663,164 @@ bool Session::closeInForceWay()
 
 void Session::sendText(const QString & text) const
 {
-    _emulation->sendText(text);
+    runInEmulation([this, text] { _emulation->sendText(text); });
 }
 
 void Session::sendKeyEvent(QKeyEvent* e) const
 {
-    _emulation->sendKeyEvent(e, false);
+    if (!_emulationThread) {
+        _emulation->sendKeyEvent(e, false);
+        return;
+    }
+
+    std::shared_ptr<QKeyEvent> event(e->clone());
+    runInEmulation([this, event] { _emulation->sendKeyEvent(event.get(), false); });
+}
+
+void Session::onViewKeyPressed(QKeyEvent* event, bool fromPaste)
+{
+    if (!_emulationThread) {
+        _emulation->sendKeyEvent(event, fromPaste);
+        return;
+    }
+
+    std::shared_ptr<QKeyEvent> copy(event->clone());
+    runInEmulation([this, copy, fromPaste] { _emulation->sendKeyEvent(copy.get(), fromPaste); });
+}
+
+void Session::onViewSendString(const char* text)
+{
+    const QByteArray copy(text);
+    runInEmulation([this, copy] { _emulation->sendString(copy.constData()); });
+}
+
+void Session::onEmulationSendData(const char* buffer, int length)
+{
+    if (QThread::currentThread() == _shellProcess->thread()) {
+        _shellProcess->sendData(buffer, length);
+        return;
+    }
+
+    const QByteArray data(buffer, length);
+    QMetaObject::invokeMethod(_shellProcess, [this, data] {
+        _shellProcess->sendData(data.constData(), data.size());
+    }, Qt::QueuedConnection);
+}
+
+void Session::runInEmulation(const std::function<void()>& function, Qt::ConnectionType type) const
+{
+    if (!_emulationThread) {
+        function();
+        return;
+    }
+
+    QMetaObject::invokeMethod(_emulation, [this, function] {
+        QMutexLocker locker(_emulation->screenLock());
+        function();
+    }, type);
+}
+
+void Session::setThreadedEmulation(bool threaded)
+{
+    if (threaded == (_emulationThread != nullptr))
+        return;
+
+    if (threaded) {
+        _emulation->setThreaded(true);
+        _emulationThread = new QThread();
+        _emulationThread->setObjectName(QLatin1String("TerminalEmulation"));
+        _emulation->moveToThread(_emulationThread);
+        _emulationThread->start();
+    } else {
+        // only the thread an object lives in can move it elsewhere
+        QThread* sessionThread = thread();
+        QMetaObject::invokeMethod(_emulation, [this, sessionThread] {
+            _emulation->moveToThread(sessionThread);
+        }, Qt::BlockingQueuedConnection);
+        _emulationThread->quit();
+        _emulationThread->wait();
+        delete _emulationThread;
+        _emulationThread = nullptr;
+        _emulation->setThreaded(false);
+    }
+}
+
+bool Session::threadedEmulation() const
+{
+    return _emulationThread != nullptr;
+}
+
+bool Session::startRecording(const QString& fileName)
+{
+    stopRecording();
+
+    auto file = std::make_unique<QFile>(fileName);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Unable to record to" << fileName << ":" << file->errorString();
+        return false;
+    }
+
+    bool started = false;
+    QFile* device = file.get();
+    runInEmulation([this, device, &started] { started = _emulation->startRecording(device); },
+                   Qt::BlockingQueuedConnection);
+    if (!started)
+        return false;
+
+    _recordingFile = std::move(file);
+    return true;
+}
+
+void Session::stopRecording()
+{
+    if (!_recordingFile)
+        return;
+
+    runInEmulation([this] { _emulation->stopRecording(); }, Qt::BlockingQueuedConnection);
+    _recordingFile.reset();
+}
+
+bool Session::isRecording() const
+{
+    return _recordingFile != nullptr;
+}
+
+void Session::receiveData(const char* buffer, int length)
+{
+    if (!_emulationThread) {
+        _emulation->receiveData(buffer, length);
+        return;
+    }
+
+    // Stop reading from the pty while the emulation lags behind by more
+    // than MaxPendingBytes and resume once it has caught up, so a flood of
+    // output cannot queue up unbounded copies of it.
+    static const int MaxPendingBytes = 4 * 1024 * 1024;
+
+    const QByteArray data(buffer, length);
+    if (_pendingEmulationBytes.fetch_add(length) + length > MaxPendingBytes
+        && !_emulationBacklogged.exchange(true)) {
+        _shellProcess->setReadingSuspended(true);
+    }
+
+    QMetaObject::invokeMethod(_emulation, [this, data] {
+        _emulation->receiveData(data.constData(), data.size());
+
+        if (_pendingEmulationBytes.fetch_sub(data.size()) - data.size() <= MaxPendingBytes / 2
+            && _emulationBacklogged.exchange(false)) {
+            QMetaObject::invokeMethod(_shellProcess, [this] {
+                _shellProcess->setReadingSuspended(false);
+            }, Qt::QueuedConnection);
+        }
+    }, Qt::QueuedConnection);
 }
 
 Session::~Session()
 {
+    stopRecording();
     close();
+    // bring the emulation and its timers back to this thread before deleting it
+    setThreadedEmulation(false);
     delete _emulation;
     delete _shellProcess;
 //  delete _zmodemProc;
@@ -733,7 +893,7 @@ int Session::sessionId() const
 
 void Session::setKeyBindings(const QString & id)
 {
-    _emulation->setKeyBindings(id);
+    runInEmulation([this, id] { _emulation->setKeyBindings(id); });
 }
 
 void Session::setTitle(TitleRole role , const QString & newTitle)
@@ -791,17 +951,19 @@ bool Session::isTitleChanged() const
 
 void Session::setHistoryType(const HistoryType & hType)
 {
-    _emulation->setHistory(hType);
+    // hType is only borrowed, so wait for the emulation to use it
+    runInEmulation([this, &hType] { _emulation->setHistory(hType); },
+                   Qt::BlockingQueuedConnection);
 }
 
-const HistoryType & Session::historyType() const
+int Session::historySize() const
 {
-    return _emulation->history();
+    return _emulation->historySize();
 }
 
 void Session::clearHistory()
 {
-    _emulation->clearHistory();
+    runInEmulation([this] { _emulation->clearHistory(); });
 }
 
 QStringList Session::arguments() const
@@ -880,6 +1042,23 @@ bool Session::flowControlEnabled() const
 {
     return _flowControl;
 }
+
+void Session::setThreadedPtyReading(bool threaded)
+{
+    if (_shellProcess) {
+        _shellProcess->setThreadedReading(threaded);
+    }
+}
+
+bool Session::threadedPtyReading() const
+{
+    return _shellProcess && _shellProcess->isThreadedReading();
+}
+
+void Session::setRawOutputTap(const RawOutputTap& tap)
+{
+    _rawOutputTap = tap;
+}
 //void Session::fireZModemDetected()
 //{
 //  if (!_zmodemBusy)
@@ -995,8 +1174,15 @@ void Session::zmodemFinished()
 */
 void Session::onReceiveBlock( const char * buf, int len )
 {
-    _emulation->receiveData( buf, len );
-    emit receivedData( QString::fromLatin1( buf, len ) );
+    receiveData( buf, len );
+
+    if (_rawOutputTap)
+        _rawOutputTap( QByteArrayView( buf, len ) );
+
+    // avoid building a string per block when nobody listens
+    static const QMetaMethod receivedDataSignal = QMetaMethod::fromSignal(&Session::receivedData);
+    if (isSignalConnected(receivedDataSignal))
+        emit receivedData( QString::fromLatin1( buf, len ) );
 }
 
 QSize Session::size()
@@ -1134,8 +1320,23 @@ void SessionGroup::connectPair(Session * master , Session * other) const
     if ( _masterMode & CopyInputToAll ) {
         qDebug() << "Connection session " << master->nameTitle() << "to" << other->nameTitle();
 
-        connect( master->emulation() , SIGNAL(sendData(const char *,int)) , other->emulation() ,
-                 SLOT(sendString(const char *,int)) );
+        // the sessions may run their emulations in different threads and the
+        // buffer is only valid during the emission, so it is copied across
+        Emulation* target = other->emulation();
+        connect( master->emulation(), &Emulation::sendData, target,
+                 [target](const char* data, int length) {
+                     if (QThread::currentThread() == target->thread()) {
+                         QMutexLocker locker(target->screenLock());
+                         target->sendString(data, length);
+                         return;
+                     }
+
+                     const QByteArray copy(data, length);
+                     QMetaObject::invokeMethod(target, [target, copy] {
+                         QMutexLocker locker(target->screenLock());
+                         target->sendString(copy.constData(), copy.size());
+                     }, Qt::QueuedConnection);
+                 }, Qt::DirectConnection );
     }
 }
 void SessionGroup::disconnectPair(Session * master , Session * other) const
@@ -1145,8 +1346,7 @@ void SessionGroup::disconnectPair(Session * master , Session * other) const
     if ( _masterMode & CopyInputToAll ) {
         qDebug() << "Disconnecting session " << master->nameTitle() << "from" << other->nameTitle();
 
-        disconnect( master->emulation() , SIGNAL(sendData(const char *,int)) , other->emulation() ,
-                    SLOT(sendString(const char *,int)) );
+        disconnect( master->emulation(), &Emulation::sendData, other->emulation(), nullptr );
     }
 }
 
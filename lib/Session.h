@@ -25,6 +25,11 @@
 #ifndef SESSION_H
 #define SESSION_H
 
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include <QByteArrayView>
 #include <QProcess>
 #include <QStringList>
 #include <QWidget>
@@ -33,6 +38,8 @@
 #include "History.h"
 
 class KProcess;
+class QFile;
+class QThread;
 
 namespace Konsole {
 
@@ -208,9 +215,10 @@ public:
      */
     void setHistoryType(const HistoryType & type);
     /**
-     * Returns the type of history store used by this session.
+     * Returns the number of lines kept by the history store of this
+     * session, 0 if it is disabled and -1 if it is unlimited.
      */
-    const HistoryType & historyType() const;
+    int historySize() const;
     /**
      * Clears the history store used by this session.
      */
@@ -310,6 +318,69 @@ public:
     /** Returns whether flow control is enabled for this terminal session. */
     bool flowControlEnabled() const;
 
+    /**
+     * Sets whether output from the terminal process is read on a dedicated
+     * I/O thread instead of the GUI thread.
+     * See Pty::setThreadedReading()
+     */
+    void setThreadedPtyReading(bool threaded);
+
+    /** Returns whether output is read on a dedicated I/O thread. */
+    bool threadedPtyReading() const;
+
+    /**
+     * Callback which is handed each block of output from the terminal
+     * process as raw bytes, before any decoding.  The data is only valid
+     * for the duration of the call.
+     */
+    typedef std::function<void(QByteArrayView data)> RawOutputTap;
+
+    /**
+     * Installs @p tap to be called for each block of output received from
+     * the terminal process, replacing any previous one.  Pass an empty
+     * function to remove it.
+     *
+     * Unlike receivedData(), this involves no conversion or copy of the data.
+     */
+    void setRawOutputTap(const RawOutputTap& tap);
+
+    /**
+     * Sets whether the emulation of this session, i.e. parsing the output
+     * of the terminal process and updating the screens, runs on a worker
+     * thread of its own instead of the thread of the session.  Views then
+     * display snapshots of the screen published at the end of each update,
+     * so sessions with a lot of output are parsed in parallel and do not
+     * hold up painting.  Disabled by default.
+     *
+     * While enabled, the emulation must only be accessed through the
+     * session, its screen windows, or with Emulation::screenLock() held.
+     * Not supported for sessions in a SessionGroup which copy input to
+     * each other.
+     */
+    void setThreadedEmulation(bool threaded);
+
+    /** Returns whether the emulation runs on a worker thread. */
+    bool threadedEmulation() const;
+
+    /**
+     * Starts recording the output of the terminal process and the changes
+     * of the terminal size to @p fileName, with timestamps and periodic
+     * keyframes.  Recordings are played back with TerminalReplayer.
+     * Returns false if the file could not be written.
+     * See Emulation::startRecording()
+     */
+    bool startRecording(const QString& fileName);
+    /** Finishes the recording started by startRecording(). */
+    void stopRecording();
+    /** Returns whether the session is being recorded. */
+    bool isRecording() const;
+
+    /**
+     * Passes @p buffer to the emulation as if it had been received from
+     * the terminal process.
+     */
+    void receiveData(const char * buffer, int length);
+
     /**
      * Sends @p text to the current foreground terminal program.
      */
@@ -433,6 +504,8 @@ signals:
 
     /**
      * Emitted when output is received from the terminal process.
+     * The bytes are converted as Latin-1, and only if the signal is
+     * connected; see setRawOutputTap() for an alternative.
      */
     void receivedData( const QString & text );
 
@@ -510,6 +583,9 @@ private slots:
 //  void fireZModemDetected();
 
     void onReceiveBlock( const char * buffer, int len );
+    void onEmulationSendData( const char * buffer, int length );
+    void onViewKeyPressed( QKeyEvent * event, bool fromPaste );
+    void onViewSendString( const char * text );
     void monitorTimerDone();
 
     void onViewSizeChange(int height, int width);
@@ -530,6 +606,10 @@ private:
     void updateTerminalSize();
     WId windowId() const;
 
+    // calls function on the emulation's thread, holding its screen lock
+    void runInEmulation(const std::function<void()>& function,
+                        Qt::ConnectionType type = Qt::QueuedConnection) const;
+
     int            _uniqueIdentifier;
 
     Pty     *_shellProcess;
@@ -569,6 +649,16 @@ private:
 
     QString        _initialWorkingDir;
 
+    RawOutputTap   _rawOutputTap;
+
+    // see setThreadedEmulation()
+    QThread*          _emulationThread;
+    std::atomic<int>  _pendingEmulationBytes;
+    std::atomic<bool> _emulationBacklogged;
+
+    // see startRecording()
+    std::unique_ptr<QFile> _recordingFile;
+
     // ZModem
 //  bool           _zmodemBusy;
 //  KProcess*      _zmodemProc;
@@ -25,6 +25,8 @@
 // Qt
 #include <QStringList>
 
+#include "qtermwidget_core_export.h"
+
 namespace Konsole {
 
 /**
@@ -48,7 +50,7 @@ namespace Konsole {
  *      </li>
  * </ul>
  */
-class ShellCommand {
+class QTERMWIDGET_CORE_EXPORT ShellCommand {
 public:
     /**
      * Constructs a ShellCommand from a command line.
@@ -23,6 +23,7 @@
 #define TERMINAL_CHARACTER_DECODER_H
 
 #include "Character.h"
+#include "qtermwidget_core_export.h"
 
 #include <QList>
 
@@ -40,7 +41,7 @@ namespace Konsole
  * Derived classes may produce either plain text with no other colour or appearance information, or
  * they may produce text which incorporates these additional properties.
  */
-class TerminalCharacterDecoder
+class QTERMWIDGET_CORE_EXPORT TerminalCharacterDecoder
 {
 public:
     virtual ~TerminalCharacterDecoder() {}
@@ -67,7 +68,7 @@ public:
  * A terminal character decoder which produces plain text, ignoring colours and other appearance-related
  * properties of the original characters.
  */
-class PlainTextDecoder : public TerminalCharacterDecoder
+class QTERMWIDGET_CORE_EXPORT PlainTextDecoder : public TerminalCharacterDecoder
 {
 public:
     PlainTextDecoder();
@@ -111,7 +112,7 @@ private:
 /**
  * A terminal character decoder which produces pretty HTML markup
  */
-class HTMLDecoder : public TerminalCharacterDecoder
+class QTERMWIDGET_CORE_EXPORT HTMLDecoder : public TerminalCharacterDecoder
 {
 public:
     /**
@@ -139,7 +140,7 @@ private:
     QTextStream* _output;
     const ColorEntry* _colorTable;
     bool _innerSpanOpen;
-    quint8 _lastRendition;
+    quint16 _lastRendition;
     CharacterColor _lastForeColor;
     CharacterColor _lastBackColor;
 
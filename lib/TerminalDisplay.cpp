@@ -46,6 +46,8 @@
 #include <QMimeData>
 #include <QDrag>
 
+#include <algorithm>
+
 // KDE
 //#include <kshell.h>
 //#include <KColorScheme>
@@ -77,25 +79,6 @@ using namespace Konsole;
                   "abcdefgjijklmnopqrstuvwxyz" \
                   "0123456789./+@"
 
-const ColorEntry Konsole::base_color_table[TABLE_COLORS] =
-// The following are almost IBM standard color codes, with some slight
-// gamma correction for the dim colors to compensate for bright X screens.
-// It contains the 8 ansiterm/xterm colors in 2 intensities.
-{
-  // Fixme: could add faint colors here, also.
-  // normal
-  ColorEntry(QColor(0x00,0x00,0x00), false), ColorEntry( QColor(0xB2,0xB2,0xB2), true), // Dfore, Dback
-  ColorEntry(QColor(0x00,0x00,0x00), false), ColorEntry( QColor(0xB2,0x18,0x18), false), // Black, Red
-  ColorEntry(QColor(0x18,0xB2,0x18), false), ColorEntry( QColor(0xB2,0x68,0x18), false), // Green, Yellow
-  ColorEntry(QColor(0x18,0x18,0xB2), false), ColorEntry( QColor(0xB2,0x18,0xB2), false), // Blue, Magenta
-  ColorEntry(QColor(0x18,0xB2,0xB2), false), ColorEntry( QColor(0xB2,0xB2,0xB2), false), // Cyan, White
-  // intensiv
-  ColorEntry(QColor(0x00,0x00,0x00), false), ColorEntry( QColor(0xFF,0xFF,0xFF), true),
-  ColorEntry(QColor(0x68,0x68,0x68), false), ColorEntry( QColor(0xFF,0x54,0x54), false),
-  ColorEntry(QColor(0x54,0xFF,0x54), false), ColorEntry( QColor(0xFF,0xFF,0x54), false),
-  ColorEntry(QColor(0x54,0x54,0xFF), false), ColorEntry( QColor(0xFF,0x54,0xFF), false),
-  ColorEntry(QColor(0x54,0xFF,0xFF), false), ColorEntry( QColor(0xFF,0xFF,0xFF), false)
-};
 
 // scroll increment used when dragging selection at top/bottom of window.
 
@@ -156,6 +139,9 @@ void TerminalDisplay::setScreenWindow(ScreenWindow* window)
         connect( _screenWindow , SIGNAL(scrolled(int)) , this , SLOT(updateFilters()) );
         connect( _screenWindow , &ScreenWindow::scrollToEnd , this , &TerminalDisplay::scrollToEnd );
         window->setWindowLines(_lines);
+        _lineGenerations.fill(0);
+        // nothing needs to be copied or compared while the display is hidden
+        window->setSuspended(!isVisible());
     }
 }
 
@@ -211,20 +197,15 @@ bool TerminalDisplay::isLineChar(Character c) const {
     return _drawLineChars && c.isLineChar();
 }
 
+bool TerminalDisplay::isLineChar(const CompactCell& cell) const {
+    return isLineChar(_styleTable.unpack(cell));
+}
+
 bool TerminalDisplay::isLineCharString(const std::wstring& string) const {
     return string.length() > 0 && _drawLineChars && (string[0] & 0xFF80) == 0x2500;
 }
 
 
-// assert for i in [0..31] : vt100extended(vt100_graphics[i]) == i.
-
-unsigned short Konsole::vt100_graphics[32] =
-{ // 0/8     1/9    2/10    3/11    4/12    5/13    6/14    7/15
-  0x0020, 0x25C6, 0x2592, 0x2409, 0x240c, 0x240d, 0x240a, 0x00b0,
-  0x00b1, 0x2424, 0x240b, 0x2518, 0x2510, 0x250c, 0x2514, 0x253c,
-  0xF800, 0xF801, 0x2500, 0xF803, 0xF804, 0x251c, 0x2524, 0x2534,
-  0x252c, 0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00b7
-};
 
 void TerminalDisplay::fontChange(const QFont&)
 {
@@ -1003,7 +984,7 @@ void TerminalDisplay::scrollImage(int lines , const QRect& screenWindowRegion)
     int linesToMove = region.height() - abs(lines);
     int bytesToMove = linesToMove *
                       this->_columns *
-                      sizeof(Character);
+                      sizeof(CompactCell);
 
     Q_ASSERT( linesToMove > 0 );
     Q_ASSERT( bytesToMove > 0 );
@@ -1037,6 +1018,9 @@ void TerminalDisplay::scrollImage(int lines , const QRect& screenWindowRegion)
     }
     scrollRect.setHeight(linesToMove * _fontHeight );
 
+    // the lines moved, so which of them changed is not known anymore
+    _lineGenerations.fill(0);
+
     Q_ASSERT(scrollRect.isValid() && !scrollRect.isEmpty());
 
     //scroll the display vertically to match internal _image
@@ -1086,15 +1070,17 @@ void TerminalDisplay::processFilters()
 
     QRegion preUpdateHotSpots = hotSpotRegion();
 
-    // use _screenWindow->getImage() here rather than _image because
+    // use _screenWindow->frame() here rather than _image because
     // other classes may call processFilters() when this display's
     // ScreenWindow emits a scrolled() signal - which will happen before
     // updateImage() is called on the display and therefore _image is
     // out of date at this point
-    _filterChain->setImage( _screenWindow->getImage(),
-                            _screenWindow->windowLines(),
-                            _screenWindow->windowColumns(),
-                            _screenWindow->getLineProperties() );
+    const std::shared_ptr<const ScreenFrame> frame = _screenWindow->frame();
+    _filterChain->setImage( frame->image.constData(),
+                            frame->lines,
+                            frame->columns,
+                            frame->lineProperties );
+    _filterGenerations = frame->lineGenerations;
     _filterChain->process();
 
     QRegion postUpdateHotSpots = hotSpotRegion();
@@ -1120,9 +1106,23 @@ void TerminalDisplay::updateImage()
      updateImageSize();
   }
 
-  Character* const newimg = _screenWindow->getImage();
-  int lines = _screenWindow->windowLines();
-  int columns = _screenWindow->windowColumns();
+  // the style table only ever grows, so once programs used a lot of
+  // different colors it is rebuilt from the styles still on display
+  if (_styleTable.size() > MAX_CELL_STYLES)
+  {
+     CellStyleTable styleTable;
+     for (int i = 0; i <= _imageSize; i++)
+         _image[i] = styleTable.pack(_styleTable.unpack(_image[i]));
+     _styleTable = std::move(styleTable);
+  }
+
+  // lines of the frame with the generation of the line in _image
+  // still hold the same characters
+  const std::shared_ptr<const ScreenFrame> frame = _screenWindow->frame();
+  const Character* const newimg = frame->image.constData();
+  int lines = frame->lines;
+  int columns = frame->columns;
+  _lineProperties = frame->lineProperties;
 
   setScroll( _screenWindow->currentLine() , _screenWindow->lineCount() );
 
@@ -1134,7 +1134,6 @@ void TerminalDisplay::updateImage()
   QPoint tL  = contentsRect().topLeft();
   int    tLx = tL.x();
   int    tLy = tL.y();
-  _hasBlinker = false;
 
   CharacterColor cf;       // undefined
   CharacterColor _clipboard;       // undefined
@@ -1143,25 +1142,68 @@ void TerminalDisplay::updateImage()
   const int linesToUpdate = qMin(this->_lines, qMax(0,lines  ));
   const int columnsToUpdate = qMin(this->_columns,qMax(0,columns));
 
+  // the selection is drawn over the image of the window, lines which
+  // were selected before or are selected now need to be compared too
+  const ScreenSelection selection = _screenWindow->selection();
+  const int firstLine = _screenWindow->currentLine();
+  int selectionChangeTop = linesToUpdate;
+  int selectionChangeBottom = -1;
+  if (selection != _selection)
+  {
+      for (const ScreenSelection& area : {selection, _selection})
+      {
+          if (!area.isValid())
+              continue;
+          selectionChangeTop = qMin(selectionChangeTop, area.topLeft / area.columns - firstLine);
+          selectionChangeBottom = qMax(selectionChangeBottom, area.bottomRight / area.columns - firstLine);
+      }
+      _selection = selection;
+  }
+
   wchar_t *disstrU = new wchar_t[columnsToUpdate];
   char *dirtyMask = new char[columnsToUpdate+2];
+  CompactCell *newCells = new CompactCell[columnsToUpdate];
+  Character *selectedLine = selection.isValid() ? new Character[columnsToUpdate] : nullptr;
   QRegion dirtyRegion;
 
   for (y = 0; y < linesToUpdate; ++y)
   {
-    const Character*       currentLine = &_image[y*this->_columns];
-    const Character* const newLine = &newimg[y*columns];
+    CompactCell* const     currentLine = &_image[y*this->_columns];
+    const Character* newLine = &newimg[y*columns];
+
+    //both the top and bottom halves of double height _lines must always be redrawn
+    const bool doubleHeight = _lineProperties.count() > y
+                              && (_lineProperties[y] & LINE_DOUBLEHEIGHT) != 0;
+
+    if (!doubleHeight && frame->lineGenerations[y] == _lineGenerations[y]
+        && (y < selectionChangeTop || y > selectionChangeBottom))
+        continue;
+    _lineGenerations[y] = frame->lineGenerations[y];
+
+    // invert the colors of the selected characters on a copy of the line
+    int selectionStart, selectionEnd;
+    if (selection.selectedColumns(firstLine + y, selectionStart, selectionEnd)
+        && selectionStart < columnsToUpdate)
+    {
+        std::copy_n(newLine, columnsToUpdate, selectedLine);
+        selectionEnd = qMin(selectionEnd, columnsToUpdate - 1);
+        for (x = selectionStart; x <= selectionEnd; x++)
+            std::swap(selectedLine[x].foregroundColor, selectedLine[x].backgroundColor);
+        newLine = selectedLine;
+    }
 
     bool updateLine = false;
+    _blinkingLines.clearBit(y);
 
     // The dirty mask indicates which characters need repainting. We also
     // mark surrounding neighbours dirty, in case the character exceeds
     // its cell boundaries
     memset(dirtyMask, 0, columnsToUpdate+2);
 
+    _styleTable.pack(newLine, newCells, columnsToUpdate);
     for( x = 0 ; x < columnsToUpdate ; ++x)
     {
-        if ( newLine[x] != currentLine[x] )
+        if ( newCells[x] != currentLine[x] )
         {
             dirtyMask[x] = true;
         }
@@ -1172,7 +1214,7 @@ void TerminalDisplay::updateImage()
     for (x = 0; x < columnsToUpdate; ++x)
     {
       if ((newLine[x].rendition & RE_BLINK) != 0) {
-        _hasBlinker = true;
+        _blinkingLines.setBit(y);
       }
 
       // Start drawing if this character or the next one differs.
@@ -1237,14 +1279,11 @@ void TerminalDisplay::updateImage()
 
     }
 
-    //both the top and bottom halves of double height _lines must always be redrawn
     //although both top and bottom halves contain the same characters, only
     //the top one is actually
     //drawn.
-    if (_lineProperties.count() > y) {
-        if ((_lineProperties[y] & LINE_DOUBLEHEIGHT) != 0) {
-            updateLine = true;
-        }
+    if (doubleHeight) {
+        updateLine = true;
     }
 
     // if the characters on the line are different in the old and the new _image
@@ -1263,7 +1302,7 @@ void TerminalDisplay::updateImage()
 
     // replace the line of characters in the old _image with the
     // current line of the new _image
-    memcpy((void*)currentLine,(const void*)newLine,columnsToUpdate*sizeof(Character));
+    memcpy(currentLine,newCells,columnsToUpdate*sizeof(CompactCell));
   }
 
   // if the new _image is smaller than the previous _image, then ensure that the area
@@ -1276,6 +1315,8 @@ void TerminalDisplay::updateImage()
                             _fontHeight * (_usedLines-linesToUpdate) );
   }
   _usedLines = linesToUpdate;
+  _blinkingLines.fill(false, linesToUpdate, _blinkingLines.size());
+  _hasBlinker = _blinkingLines.count(true) > 0;
 
   if ( columnsToUpdate < _usedColumns )
   {
@@ -1293,6 +1334,8 @@ void TerminalDisplay::updateImage()
 
   if ( _hasBlinker && !_blinkTimer->isActive()) _blinkTimer->start( TEXT_BLINK_DELAY );
   if (!_hasBlinker && _blinkTimer->isActive()) { _blinkTimer->stop(); _blinking = false; }
+  delete[] newCells;
+  delete[] selectedLine;
   delete[] dirtyMask;
   delete[] disstrU;
 
@@ -1553,11 +1596,11 @@ void TerminalDisplay::drawInputMethodPreeditString(QPainter& painter , const QRe
     bool invertColors = false;
     const QColor background = _colorTable[DEFAULT_BACK_COLOR].color;
     const QColor foreground = _colorTable[DEFAULT_FORE_COLOR].color;
-    const Character* style = &_image[loc(cursorPos.x(),cursorPos.y())];
+    const Character style = _styleTable.unpack(_image[loc(cursorPos.x(),cursorPos.y())]);
 
     drawBackground(painter,rect,background,true);
     drawCursor(painter,rect,foreground,background,invertColors);
-    drawCharacters(painter,rect,_inputMethodData.preeditString,style,invertColors);
+    drawCharacters(painter,rect,_inputMethodData.preeditString,&style,invertColors);
 
     _inputMethodData.previousPreeditRect = rect;
 }
@@ -1580,9 +1623,9 @@ void TerminalDisplay::paintFilters(QPainter& painter)
                         ? _scrollBar->width() : 0);
 
     getCharacterPosition( cursorPos , cursorLine , cursorColumn );
-    Character cursorCharacter = _image[loc(cursorColumn,cursorLine)];
+    const CellStyle& cursorStyle = _styleTable.style(_image[loc(cursorColumn,cursorLine)].style);
 
-    painter.setPen( QPen(cursorCharacter.foregroundColor.color(colorTable())) );
+    painter.setPen( QPen(cursorStyle.foregroundColor.color(colorTable())) );
 
     // iterate over hotspots identified by the display's currently active filters
     // and draw appropriate visuals to indicate the presence of the hotspot
@@ -1690,7 +1733,7 @@ int TerminalDisplay::textWidth(const int startColumn, const int length, const in
   int result = 0;
   for (int column = 0; column < length; column++)
   {
-    auto c = _image[loc(startColumn + column, line)];
+    const CompactCell& c = _image[loc(startColumn + column, line)];
     // Take care of double-column characters and those with small widths.
     // Exclude line characters, as some of them are ambiguous ('A') [1]
     // [1] http://www.unicode.org/Public/UCD/latest/ucd/EastAsianWidth.txt
@@ -1747,7 +1790,7 @@ void TerminalDisplay::drawContents(QPainter &paint, const QRect &rect)
       unistr.resize(bufferSize);
 
       // is this a single character or a sequence of characters ?
-      if ( _image[loc(x,y)].rendition & RE_EXTENDED_CHAR )
+      if ( _styleTable.style(_image[loc(x,y)].style).rendition & RE_EXTENDED_CHAR )
       {
         // sequence of characters
         ushort extendedCharLength = 0;
@@ -1782,17 +1825,13 @@ void TerminalDisplay::drawContents(QPainter &paint, const QRect &rect)
       bool bigWidth = _fixedFont && !doubleWidth && charWidth > _fontWidth;
       bool tooWide = bigWidth && charWidth >= 2 * _fontWidth;
       bool smallWidth = _fixedFont && c && charWidth < _fontWidth;
-      CharacterColor currentForeground = _image[loc(x,y)].foregroundColor;
-      CharacterColor currentBackground = _image[loc(x,y)].backgroundColor;
-      quint8 currentRendition = _image[loc(x,y)].rendition;
+      const quint32 currentStyle = _image[loc(x,y)].style;
 
       quint32 nxtC = 0;
       bool nxtDoubleWidth = false;
       int nxtCharWidth = 0;
       while (x+len <= rlx &&
-             _image[loc(x+len,y)].foregroundColor == currentForeground &&
-             _image[loc(x+len,y)].backgroundColor == currentBackground &&
-             _image[loc(x+len,y)].rendition == currentRendition &&
+             _image[loc(x+len,y)].style == currentStyle &&
              (nxtDoubleWidth = (_image[qMin(loc(x+len,y)+1,_imageSize)].character == 0)) == doubleWidth &&
              !smallWidth &&
              !(_fixedFont && (nxtC = _image[loc(x+len,y)].character) && (nxtCharWidth = fm.horizontalAdvance(QChar(nxtC))) < _fontWidth) &&
@@ -1801,7 +1840,7 @@ void TerminalDisplay::drawContents(QPainter &paint, const QRect &rect)
              isLineChar(_image[loc(x+len,y)]) == lineDraw) // Assignment!
       {
         c = _image[loc(x+len,y)].character;
-        if (_image[loc(x+len,y)].rendition & RE_EXTENDED_CHAR)
+        if (_styleTable.style(currentStyle).rendition & RE_EXTENDED_CHAR)
         {
             // sequence of characters
             ushort extendedCharLength = 0;
@@ -1867,10 +1906,11 @@ void TerminalDisplay::drawContents(QPainter &paint, const QRect &rect)
          textArea.moveTopLeft( textScale.inverted().map(textArea.topLeft()) );
 
          //paint text fragment
+         const Character fragmentStyle = _styleTable.unpack(_image[loc(x,y)]);
          drawTextFragment(paint,
                           textArea,
                           unistr,
-                          &_image[loc(x,y)],
+                          &fragmentStyle,
                           tooWide);
 
          _fixedFont = save__fixedFont;
@@ -1957,7 +1997,7 @@ void TerminalDisplay::propagateSize()
 
 void TerminalDisplay::updateImageSize()
 {
-  Character* oldimg = _image;
+  CompactCell* oldimg = _image;
   int oldlin = _lines;
   int oldcol = _columns;
 
@@ -1972,7 +2012,7 @@ void TerminalDisplay::updateImageSize()
     for (int line = 0; line < lines; line++)
     {
       memcpy((void*)&_image[_columns*line],
-             (void*)&oldimg[oldcol*line],columns*sizeof(Character));
+             (void*)&oldimg[oldcol*line],columns*sizeof(CompactCell));
     }
     delete[] oldimg;
   }
@@ -1996,12 +2036,19 @@ void TerminalDisplay::updateImageSize()
 //
 //TODO: Perhaps it would be better to have separate signals for show and hide instead of using
 //the same signal as the one for a content size change
+//
+//While hidden, the screen window is suspended so that output costs no more than parsing it,
+//showing the display again updates the image once.
 void TerminalDisplay::showEvent(QShowEvent*)
 {
+    if (_screenWindow)
+        _screenWindow->setSuspended(false);
     emit changedContentSizeSignal(_contentHeight,_contentWidth);
 }
 void TerminalDisplay::hideEvent(QHideEvent*)
 {
+    if (_screenWindow)
+        _screenWindow->setSuspended(true);
     emit changedContentSizeSignal(_contentHeight,_contentWidth);
 }
 
@@ -2619,6 +2666,11 @@ void TerminalDisplay::updateFilters()
     if ( !_screenWindow )
         return;
 
+    // e.g. while the window is scrolled back, output often does not
+    // change any of the visible lines
+    if (_screenWindow->frame()->lineGenerations == _filterGenerations)
+        return;
+
     processFilters();
 }
 
@@ -2705,7 +2757,7 @@ void TerminalDisplay::mouseDoubleClickEvent(QMouseEvent* ev)
      // In word selection mode don't select @ (64) if at end of word.
      if (QChar(_image[i].character) == QLatin1Char('@') &&
          endSel.x() - bgnSel.x() > 0 &&
-         (_image[i].rendition & RE_EXTENDED_CHAR) == 0)
+         (_styleTable.style(_image[i].style).rendition & RE_EXTENDED_CHAR) == 0)
      {
        endSel.setX( x - 1 );
      }
@@ -2846,12 +2898,12 @@ bool TerminalDisplay::focusNextPrevChild( bool next )
 }
 
 
-QChar TerminalDisplay::charClass(const Character &ch) const
+QChar TerminalDisplay::charClass(const CompactCell& cell) const
 {
-    if (ch.rendition & RE_EXTENDED_CHAR)
+    if (_styleTable.style(cell.style).rendition & RE_EXTENDED_CHAR)
     {
         ushort extendedCharLength = 0;
-        const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(ch.character, extendedCharLength);
+        const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(cell.character, extendedCharLength);
         if (chars && extendedCharLength > 0)
         {
             std::wstring str;
@@ -2871,7 +2923,7 @@ QChar TerminalDisplay::charClass(const Character &ch) const
     }
     else
     {
-        const QChar qch(ch.character);
+        const QChar qch(cell.character);
         if (qch.isSpace())
             return QLatin1Char(' ');
         if (qch.isLetterOrNumber() || _wordCharacters.contains(qch, Qt::CaseInsensitive ))
@@ -3119,7 +3171,10 @@ QVariant TerminalDisplay::inputMethodQuery( Qt::InputMethodQuery query ) const
                 QTextStream stream(&lineText);
                 PlainTextDecoder decoder;
                 decoder.begin(&stream);
-                decoder.decodeLine(&_image[loc(0,cursorPos.y())],_usedColumns,0);
+                QVector<Character> line(_usedColumns);
+                for (int x = 0; x < _usedColumns; x++)
+                    line[x] = _styleTable.unpack(_image[loc(x,cursorPos.y())]);
+                decoder.decodeLine(line.data(),_usedColumns,0);
                 decoder.end();
                 return lineText;
             }
@@ -3257,15 +3312,12 @@ void TerminalDisplay::swapColorTable()
 void TerminalDisplay::clearImage()
 {
   // We initialize _image[_imageSize] too. See makeImage()
+  const CompactCell blank = _styleTable.pack(Character());
   for (int i = 0; i <= _imageSize; i++)
-  {
-    _image[i].character = ' ';
-    _image[i].foregroundColor = CharacterColor(COLOR_SPACE_DEFAULT,
-                                               DEFAULT_FORE_COLOR);
-    _image[i].backgroundColor = CharacterColor(COLOR_SPACE_DEFAULT,
-                                               DEFAULT_BACK_COLOR);
-    _image[i].rendition = DEFAULT_RENDITION;
-  }
+    _image[i] = blank;
+
+  _blinkingLines.fill(false, _lines);
+  _lineGenerations.fill(0, _lines);
 }
 
 void TerminalDisplay::calcGeometry()
@@ -3319,7 +3371,7 @@ void TerminalDisplay::makeImage()
 
   // We over-commit one character so that we can be more relaxed in dealing with
   // certain boundary conditions: _image[_imageSize] is a valid but unused position
-  _image = new Character[_imageSize+1];
+  _image = new CompactCell[_imageSize+1];
 
   clearImage();
 }
@@ -22,6 +22,7 @@
 #define TERMINALDISPLAY_H
 
 // Qt
+#include <QBitArray>
 #include <QColor>
 #include <QPointer>
 #include <QScrollBar>
@@ -29,9 +30,10 @@
 // Konsole
 #include "Filter.h"
 #include "Character.h"
+#include "CompactCell.h"
+#include "Screen.h"
 #include "qtermwidget.h"
 //#include "konsole_export.h"
-#define KONSOLEPRIVATE_EXPORT
 
 class QDrag;
 class QDragEnterEvent;
@@ -69,8 +71,6 @@ namespace Konsole
         Center
     };
 
-extern unsigned short vt100_graphics[32];
-
 class ScreenWindow;
 class ScrollBar;
 
@@ -83,7 +83,7 @@ class ScrollBar;
  *
  * TODO More documentation
  */
-class KONSOLEPRIVATE_EXPORT TerminalDisplay : public QWidget
+class QTERMWIDGET_EXPORT TerminalDisplay : public QWidget
 {
    Q_OBJECT
 
@@ -626,7 +626,7 @@ protected:
     //     - A space (returns ' ')
     //     - Part of a word (returns 'a')
     //     - Other characters (returns the input character)
-    QChar charClass(const Character &ch) const;
+    QChar charClass(const CompactCell& cell) const;
 
     void clearImage();
 
@@ -733,6 +733,7 @@ private:
     bool handleShortcutOverrideEvent(QKeyEvent* event);
 
     bool isLineChar(Character c) const;
+    bool isLineChar(const CompactCell& cell) const;
     bool isLineCharString(const std::wstring& string) const;
 
     void hideStaleMouse() const; // conditionally hides the mouse cursor
@@ -770,8 +771,12 @@ private:
 
     int _contentHeight;
     int _contentWidth;
-    Character* _image; // [lines][columns]
+    CompactCell* _image; // [lines][columns]
                // only the area [usedLines][usedColumns] in the image contains valid data
+    CellStyleTable _styleTable; // the styles of the cells in _image
+    QVector<quint64> _lineGenerations; // ScreenFrame::lineGenerations of the lines in _image, 0 if unknown
+    QVector<quint64> _filterGenerations; // ScreenFrame::lineGenerations of the lines the filters last processed
+    ScreenSelection _selection; // the selection drawn into _image
 
     int _imageSize;
     QVector<LineProperty> _lineProperties;
@@ -804,6 +809,7 @@ private:
 
     bool _blinking;   // hide text in paintEvent
     bool _hasBlinker; // has characters to blink
+    QBitArray _blinkingLines; // lines of _image with characters to blink, see _hasBlinker
     bool _cursorBlinking;     // hide cursor in paintEvent
     bool _hasBlinkingCursor;  // has blinking cursor enabled
     bool _allowBlinkingText;  // allow text to blink
@@ -870,6 +876,9 @@ private:
     //the delay in milliseconds between redrawing blinking text
     static const int TEXT_BLINK_DELAY = 500;
 
+    //the number of styles after which _styleTable is rebuilt
+    static const int MAX_CELL_STYLES = 65536;
+
     int _leftBaseMargin;
     int _topBaseMargin;
 
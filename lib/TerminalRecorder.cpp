@@ -0,0 +1,120 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "TerminalRecorder.h"
+
+// Qt
+#include <QBuffer>
+#include <QDateTime>
+#include <QIODevice>
+
+// Konsole
+#include "Emulation.h"
+
+using namespace Konsole;
+using namespace Konsole::Recording;
+
+// keyframes are also taken after this much output, so that seeking
+// never has to play back more than a few megabytes
+static const qint64 KeyframeBytes = 4 * 1024 * 1024;
+
+TerminalRecorder::TerminalRecorder(Emulation* emulation, QIODevice* device, int keyframeInterval)
+    : _emulation(emulation)
+    , _device(device)
+    , _stream(device)
+    , _keyframeInterval(qMax(0, keyframeInterval))
+    , _lastKeyframeTime(0)
+    , _bytesSinceKeyframe(0)
+    , _finished(false)
+{
+    _stream.setVersion(StreamVersion);
+}
+
+bool TerminalRecorder::start()
+{
+    if (!_device || !_device->isWritable() || _device->isSequential())
+        return false;
+
+    _clock.start();
+    _stream << Magic << Version << QDateTime::currentMSecsSinceEpoch();
+    writeKeyframe();
+    return _stream.status() == QDataStream::Ok;
+}
+
+quint32 TerminalRecorder::elapsed() const
+{
+    return static_cast<quint32>(qMin<qint64>(_clock.elapsed(), 0xffffffff));
+}
+
+void TerminalRecorder::recordOutput(const char* data, int length)
+{
+    if (_finished || length <= 0)
+        return;
+
+    _stream << quint8(OutputRecord) << elapsed() << quint32(length);
+    _stream.writeRawData(data, length);
+
+    // a keyframe taken within an escape sequence would lose the start of
+    // it, so it waits for the first block which ends outside of one
+    _bytesSinceKeyframe += length;
+    const bool due = _bytesSinceKeyframe >= KeyframeBytes
+                  || _clock.elapsed() - _lastKeyframeTime >= _keyframeInterval;
+    if (due && !_emulation->hasPendingSequence())
+        writeKeyframe();
+}
+
+void TerminalRecorder::recordResize(int lines, int columns)
+{
+    if (_finished)
+        return;
+
+    _stream << quint8(ResizeRecord) << elapsed() << qint32(lines) << qint32(columns);
+}
+
+void TerminalRecorder::writeKeyframe()
+{
+    QByteArray state;
+    QBuffer buffer(&state);
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream stateStream(&buffer);
+    stateStream.setVersion(StreamVersion);
+    _emulation->saveState(stateStream);
+
+    const quint32 time = elapsed();
+    _keyframes.append({time, _device->pos()});
+    _stream << quint8(KeyframeRecord) << time << quint32(state.size());
+    _stream.writeRawData(state.constData(), state.size());
+
+    _lastKeyframeTime = _clock.elapsed();
+    _bytesSinceKeyframe = 0;
+}
+
+void TerminalRecorder::finish()
+{
+    if (_finished)
+        return;
+    _finished = true;
+
+    const qint64 indexOffset = _device->pos();
+    _stream << quint8(IndexRecord) << elapsed() << quint32(_keyframes.size());
+    for (const Keyframe& keyframe : std::as_const(_keyframes))
+        _stream << keyframe.time << keyframe.offset;
+    _stream << indexOffset << IndexMagic;
+}
@@ -0,0 +1,125 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef TERMINALRECORDER_H
+#define TERMINALRECORDER_H
+
+// Qt
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QVector>
+
+class QIODevice;
+
+namespace Konsole
+{
+
+class Emulation;
+
+/**
+ * The file format of terminal recordings, written by TerminalRecorder and
+ * read by TerminalReplayer.  All numbers are big endian.
+ *
+ * The file starts with a header:
+ *   magic "QTWR" (quint32), version (quint16),
+ *   start of the recording in milliseconds since the epoch (qint64)
+ *
+ * followed by records of a type (quint8), the time in milliseconds since
+ * the start (quint32) and a payload depending on the type:
+ *   Output:   length (quint32) and the bytes received from the program
+ *   Resize:   lines and columns (qint32)
+ *   Keyframe: length (quint32) and the data of Emulation::saveState()
+ *   Index:    count (quint32), then the time (quint32) and file offset
+ *             (qint64) of each keyframe record
+ *
+ * A finished recording ends with an Index record and a trailer of the
+ * offset of the index record (qint64) and the magic "QTWI" (quint32).
+ * Recordings which were not finished lack both and are read up to their
+ * last complete record.
+ */
+namespace Recording
+{
+    const quint32 Magic = 0x51545752;      // "QTWR"
+    const quint32 IndexMagic = 0x51545749; // "QTWI"
+    // version 2 stores renditions as quint16, version 1 had one byte
+    const quint16 Version = 2;
+    const int HeaderSize = 4 + 2 + 8;
+    const int TrailerSize = 8 + 4;
+    const QDataStream::Version StreamVersion = QDataStream::Qt_6_0;
+
+    enum RecordType
+    {
+        OutputRecord = 1,
+        ResizeRecord = 2,
+        KeyframeRecord = 3,
+        IndexRecord = 4
+    };
+
+    struct Keyframe
+    {
+        quint32 time;
+        qint64 offset;
+    };
+}
+
+/**
+ * Writes the output received by an emulation and the changes of its size
+ * to a device in the Recording format.  Created by
+ * Emulation::startRecording() and called from the emulation with its
+ * screen lock held.
+ */
+class TerminalRecorder
+{
+public:
+    /**
+     * Constructs a recorder which writes to @p device, taking a keyframe
+     * of @p emulation every @p keyframeInterval milliseconds of output.
+     */
+    TerminalRecorder(Emulation* emulation, QIODevice* device, int keyframeInterval);
+
+    /**
+     * Writes the header and the first keyframe.  Returns false if the
+     * device is not writable.
+     */
+    bool start();
+    /** Records a block of output after the emulation has processed it. */
+    void recordOutput(const char* data, int length);
+    /** Records a change of the size of the emulation. */
+    void recordResize(int lines, int columns);
+    /** Writes the keyframe index, after which nothing more is recorded. */
+    void finish();
+
+private:
+    quint32 elapsed() const;
+    void writeKeyframe();
+
+    Emulation* _emulation;
+    QIODevice* _device;
+    QDataStream _stream;
+    QElapsedTimer _clock;
+    int _keyframeInterval;
+    qint64 _lastKeyframeTime;
+    qint64 _bytesSinceKeyframe;
+    QVector<Recording::Keyframe> _keyframes;
+    bool _finished;
+};
+
+}
+
+#endif // TERMINALRECORDER_H
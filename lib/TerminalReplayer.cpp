@@ -0,0 +1,406 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "TerminalReplayer.h"
+
+// Standard Library
+#include <algorithm>
+
+// Qt
+#include <QFile>
+#include <QtDebug>
+
+// Konsole
+#include "Emulation.h"
+#include "TerminalRecorder.h"
+
+using namespace Konsole;
+using namespace Konsole::Recording;
+
+// playing as fast as possible returns to the event loop after this long,
+// so that views are updated and input is handled in between
+static const int MaxPlaybackSlice = 20;
+
+TerminalReplayer::TerminalReplayer(Emulation* emulation, QObject* parent)
+    : QObject(parent)
+    , _emulation(emulation)
+    , _device(nullptr)
+    , _duration(0)
+    , _endOffset(0)
+    , _position(0)
+    , _speed(1)
+    , _playing(false)
+    , _clockStart(0)
+{
+    _stream.setVersion(StreamVersion);
+    _timer.setSingleShot(true);
+    connect(&_timer, &QTimer::timeout, this, &TerminalReplayer::playPendingRecords);
+}
+
+TerminalReplayer::~TerminalReplayer()
+{
+    close();
+}
+
+bool TerminalReplayer::open(const QString& fileName)
+{
+    auto file = std::make_unique<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Unable to open recording" << fileName << ":" << file->errorString();
+        return false;
+    }
+    if (!open(file.get()))
+        return false;
+
+    _ownedDevice = std::move(file);
+    return true;
+}
+
+bool TerminalReplayer::open(QIODevice* device)
+{
+    close();
+
+    if (!device || !device->isReadable() || device->isSequential())
+        return false;
+
+    _device = device;
+    _stream.setDevice(device);
+    _device->seek(0);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint64 startTime = 0;
+    _stream >> magic >> version >> startTime;
+    if (_stream.status() != QDataStream::Ok || magic != Magic || version != Version)
+    {
+        qWarning() << "Not a terminal recording or one of another version";
+        close();
+        return false;
+    }
+    _startTime = QDateTime::fromMSecsSinceEpoch(startTime);
+
+    if (!readIndex())
+        scanRecords();
+
+    if (_keyframes.isEmpty() || !seek(0))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TerminalReplayer::close()
+{
+    pause();
+    _stream.setDevice(nullptr);
+    _device = nullptr;
+    _ownedDevice.reset();
+    _keyframes.clear();
+    _duration = 0;
+    _endOffset = 0;
+    _position = 0;
+}
+
+bool TerminalReplayer::isOpen() const
+{
+    return _device != nullptr;
+}
+
+QDateTime TerminalReplayer::startTime() const
+{
+    return _startTime;
+}
+
+qint64 TerminalReplayer::duration() const
+{
+    return _duration;
+}
+
+qint64 TerminalReplayer::position() const
+{
+    return _position;
+}
+
+void TerminalReplayer::setSpeed(qreal speed)
+{
+    speed = qMax<qreal>(0, speed);
+    if (_playing)
+    {
+        // restart the clock so the time played so far keeps its speed
+        _clockStart = _position;
+        _clock.start();
+    }
+    _speed = speed;
+}
+
+qreal TerminalReplayer::speed() const
+{
+    return _speed;
+}
+
+bool TerminalReplayer::isPlaying() const
+{
+    return _playing;
+}
+
+void TerminalReplayer::play()
+{
+    if (!_device || _playing)
+        return;
+
+    _playing = true;
+    _clockStart = _position;
+    _clock.start();
+    _timer.start(0);
+}
+
+void TerminalReplayer::pause()
+{
+    _playing = false;
+    _timer.stop();
+}
+
+bool TerminalReplayer::readRecord(Record& record, bool withData)
+{
+    record.offset = _device->pos();
+    if (_endOffset > 0 && record.offset >= _endOffset)
+        return false;
+
+    _stream >> record.type >> record.time;
+    record.data.clear();
+
+    switch (record.type)
+    {
+        case OutputRecord:
+        case KeyframeRecord:
+        {
+            quint32 length = 0;
+            _stream >> length;
+            if (_stream.status() != QDataStream::Ok)
+                return false;
+            if (withData)
+            {
+                record.data.resize(length);
+                if (_stream.readRawData(record.data.data(), length) != int(length))
+                    return false;
+            }
+            else if (_stream.skipRawData(length) != int(length))
+            {
+                return false;
+            }
+            break;
+        }
+        case ResizeRecord:
+            _stream >> record.lines >> record.columns;
+            break;
+        default:
+            // the index or a damaged record, either way the end
+            return false;
+    }
+
+    return _stream.status() == QDataStream::Ok;
+}
+
+void TerminalReplayer::applyRecord(const Record& record)
+{
+    if (record.type == OutputRecord)
+        _emulation->receiveData(record.data.constData(), record.data.size());
+    else if (record.type == ResizeRecord)
+        _emulation->setImageSize(record.lines, record.columns);
+}
+
+bool TerminalReplayer::restoreKeyframe(qint64 offset)
+{
+    _device->seek(offset);
+    _stream.resetStatus();
+
+    Record record;
+    if (!readRecord(record, true) || record.type != KeyframeRecord)
+        return false;
+
+    QDataStream state(record.data);
+    state.setVersion(StreamVersion);
+    if (!_emulation->restoreState(state))
+        return false;
+
+    _position = record.time;
+    return true;
+}
+
+bool TerminalReplayer::readIndex()
+{
+    const qint64 size = _device->size();
+    if (size < HeaderSize + TrailerSize)
+        return false;
+
+    qint64 indexOffset = 0;
+    quint32 magic = 0;
+    _device->seek(size - TrailerSize);
+    _stream >> indexOffset >> magic;
+    if (_stream.status() != QDataStream::Ok || magic != IndexMagic
+        || indexOffset < HeaderSize || indexOffset >= size - TrailerSize)
+    {
+        _stream.resetStatus();
+        return false;
+    }
+
+    quint8 type = 0;
+    quint32 time = 0;
+    quint32 count = 0;
+    _device->seek(indexOffset);
+    _stream >> type >> time >> count;
+    if (_stream.status() != QDataStream::Ok || type != IndexRecord
+        || count > quint64(size - indexOffset) / 12)
+    {
+        _stream.resetStatus();
+        return false;
+    }
+
+    _keyframes.resize(count);
+    for (Keyframe& keyframe : _keyframes)
+        _stream >> keyframe.time >> keyframe.offset;
+    if (_stream.status() != QDataStream::Ok)
+    {
+        _keyframes.clear();
+        _stream.resetStatus();
+        return false;
+    }
+
+    _duration = time;
+    _endOffset = indexOffset;
+    return true;
+}
+
+void TerminalReplayer::scanRecords()
+{
+    // the recording was not finished, so find the keyframes and the end
+    // by reading the headers of all records
+    _device->seek(HeaderSize);
+    _stream.resetStatus();
+
+    Record record;
+    qint64 end = HeaderSize;
+    while (readRecord(record, false))
+    {
+        if (record.type == KeyframeRecord)
+            _keyframes.append({record.time, record.offset});
+        _duration = record.time;
+        end = _device->pos();
+    }
+
+    _endOffset = end;
+    _stream.resetStatus();
+}
+
+bool TerminalReplayer::seek(qint64 msecs)
+{
+    if (!_device || _keyframes.isEmpty())
+        return false;
+
+    msecs = qBound<qint64>(0, msecs, _duration);
+
+    // the last keyframe at or before msecs
+    auto keyframe = std::upper_bound(_keyframes.cbegin(), _keyframes.cend(), msecs,
+                                     [](qint64 time, const Keyframe& k) { return time < k.time; });
+    if (keyframe != _keyframes.cbegin())
+        --keyframe;
+
+    if (!restoreKeyframe(keyframe->offset))
+    {
+        qWarning() << "Damaged keyframe in terminal recording";
+        pause();
+        return false;
+    }
+
+    Record record;
+    qint64 next = _device->pos();
+    while (readRecord(record, true) && record.time <= msecs)
+    {
+        applyRecord(record);
+        next = _device->pos();
+    }
+    _device->seek(next);
+    _stream.resetStatus();
+
+    _position = msecs;
+    if (_playing)
+    {
+        _clockStart = _position;
+        _clock.start();
+    }
+    emit positionChanged(_position);
+    return true;
+}
+
+void TerminalReplayer::playPendingRecords()
+{
+    if (!_playing)
+        return;
+
+    QElapsedTimer slice;
+    slice.start();
+
+    const qint64 target = _speed > 0 ? _clockStart + qint64(_clock.elapsed() * _speed)
+                                     : _duration;
+    Record record;
+    qint64 next = _device->pos();
+    bool more = false;
+    while (readRecord(record, true))
+    {
+        if (record.time > target)
+        {
+            more = true;
+            break;
+        }
+        applyRecord(record);
+        _position = record.time;
+        next = _device->pos();
+
+        if (slice.elapsed() >= MaxPlaybackSlice)
+        {
+            more = true;
+            break;
+        }
+    }
+    _device->seek(next);
+    _stream.resetStatus();
+
+    if (!more)
+    {
+        _position = _duration;
+        emit positionChanged(_position);
+        pause();
+        emit finished();
+        return;
+    }
+
+    if (_speed > 0 && record.time > target)
+    {
+        _position = target;
+        _timer.start(int(qMin<qint64>((record.time - target) / _speed, 1000)));
+    }
+    else
+    {
+        _timer.start(0);
+    }
+    emit positionChanged(_position);
+}
@@ -0,0 +1,163 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef TERMINALREPLAYER_H
+#define TERMINALREPLAYER_H
+
+// Qt
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+// Standard Library
+#include <memory>
+
+#include "qtermwidget_core_export.h"
+
+class QIODevice;
+
+namespace Konsole
+{
+
+class Emulation;
+
+/**
+ * Plays back a recording made with Emulation::startRecording() into an
+ * emulation, e.g. the one of a HeadlessSession or of a QTermWidget which
+ * was created without starting a program.
+ *
+ * The recording can be played at its original speed, faster or slower
+ * with setSpeed(), or as fast as possible with a speed of 0.  seek()
+ * restores the nearest keyframe before the requested time and plays back
+ * only the output after it.
+ *
+ * Keyframes do not include the history, so lines which scrolled off the
+ * screen before the last keyframe are not available after seeking.
+ */
+class QTERMWIDGET_CORE_EXPORT TerminalReplayer : public QObject
+{
+Q_OBJECT
+
+public:
+    /** Constructs a replayer which plays recordings into @p emulation */
+    explicit TerminalReplayer(Emulation* emulation, QObject* parent = nullptr);
+    ~TerminalReplayer() override;
+
+    /**
+     * Opens the recording in @p fileName and restores the emulation to the
+     * state at its start.  Returns false if the file is not a recording.
+     */
+    bool open(const QString& fileName);
+    /**
+     * Like open(const QString&) but reads from @p device, which must be
+     * open for reading, seekable and outlive the replayer or close().
+     */
+    bool open(QIODevice* device);
+    /** Stops playing and closes the recording */
+    void close();
+    /** Returns whether a recording is open */
+    bool isOpen() const;
+
+    /** Returns the time the recording was started at */
+    QDateTime startTime() const;
+    /** Returns the length of the recording in milliseconds */
+    qint64 duration() const;
+    /** Returns the time in the recording the emulation shows, in milliseconds */
+    qint64 position() const;
+
+    /**
+     * Sets how fast the recording is played: 1 plays it at its original
+     * speed, 2 twice as fast and 0 as fast as possible.  Defaults to 1.
+     */
+    void setSpeed(qreal speed);
+    /** Returns the playback speed.  See setSpeed() */
+    qreal speed() const;
+
+    /** Returns whether the recording is playing */
+    bool isPlaying() const;
+
+public slots:
+    /** Plays the recording from the current position */
+    void play();
+    /** Stops playing at the current position */
+    void pause();
+    /**
+     * Brings the emulation into the state at @p msecs into the recording.
+     * Returns false if the recording could not be read.
+     */
+    bool seek(qint64 msecs);
+
+signals:
+    /** Emitted while playing as the position advances */
+    void positionChanged(qint64 msecs);
+    /** Emitted when playing reaches the end of the recording */
+    void finished();
+
+private slots:
+    void playPendingRecords();
+
+private:
+    struct Record
+    {
+        quint8 type;
+        quint32 time;
+        qint64 offset;
+        QByteArray data;
+        qint32 lines;
+        qint32 columns;
+    };
+
+    // reads the next record, skipping the payload unless withData is set
+    bool readRecord(Record& record, bool withData);
+    // applies an output or resize record to the emulation
+    void applyRecord(const Record& record);
+    bool restoreKeyframe(qint64 offset);
+    bool readIndex();
+    void scanRecords();
+
+    Emulation* _emulation;
+    QIODevice* _device;
+    std::unique_ptr<QIODevice> _ownedDevice;
+    QDataStream _stream;
+
+    QDateTime _startTime;
+    qint64 _duration;
+    qint64 _endOffset;
+    struct Keyframe
+    {
+        quint32 time;
+        qint64 offset;
+    };
+    QVector<Keyframe> _keyframes;
+
+    qint64 _position;
+    qreal _speed;
+    bool _playing;
+    // the position when the clock was started and the wall time since
+    QElapsedTimer _clock;
+    qint64 _clockStart;
+    QTimer _timer;
+};
+
+}
+
+#endif // TERMINALREPLAYER_H
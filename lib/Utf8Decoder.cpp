@@ -0,0 +1,147 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "Utf8Decoder.h"
+
+// Standard Library
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace Konsole;
+
+namespace
+{
+
+const wchar_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Returns the number of leading bytes of @p text which are plain 7-bit
+// ASCII, classifying 16 bytes per step.
+inline int asciiPrefixLength(const unsigned char* text, int length)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= length; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        const int highBits = _mm_movemask_epi8(block);
+        if (highBits)
+            return i + __builtin_ctz(highBits);
+    }
+#else
+    for (; i + 16 <= length; i += 16) {
+        uint64_t first, second;
+        memcpy(&first, text + i, sizeof(first));
+        memcpy(&second, text + i + 8, sizeof(second));
+        if ((first | second) & UINT64_C(0x8080808080808080))
+            break;
+    }
+#endif
+    while (i < length && text[i] < 0x80)
+        ++i;
+    return i;
+}
+
+inline wchar_t* appendCodePoint(wchar_t* out, char32_t codePoint)
+{
+    if (sizeof(wchar_t) == 2 && codePoint > 0xFFFF) {
+        codePoint -= 0x10000;
+        *out++ = static_cast<wchar_t>(0xD800 + (codePoint >> 10));
+        *out++ = static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF));
+    } else {
+        *out++ = static_cast<wchar_t>(codePoint);
+    }
+    return out;
+}
+
+}
+
+Utf8Decoder::Utf8Decoder()
+{
+    reset();
+}
+
+void Utf8Decoder::reset()
+{
+    _codePoint = 0;
+    _remaining = 0;
+    _lowerBound = 0x80;
+    _upperBound = 0xBF;
+}
+
+int Utf8Decoder::decode(const char* text, int length, wchar_t* output)
+{
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(text);
+    const unsigned char* const end = in + length;
+    wchar_t* out = output;
+
+    while (in < end) {
+        if (_remaining == 0) {
+            // hand runs of ASCII straight through
+            const int ascii = asciiPrefixLength(in, static_cast<int>(end - in));
+            for (int i = 0; i < ascii; i++)
+                out[i] = in[i];
+            in += ascii;
+            out += ascii;
+            if (in == end)
+                break;
+
+            // start of a multi-byte sequence
+            const unsigned char lead = *in++;
+            if (lead < 0xC2 || lead > 0xF4) {
+                // continuation byte, overlong 2-byte lead or beyond U+10FFFF
+                *out++ = REPLACEMENT_CHARACTER;
+                continue;
+            }
+            if (lead < 0xE0) {
+                _codePoint = lead & 0x1F;
+                _remaining = 1;
+            } else if (lead < 0xF0) {
+                _codePoint = lead & 0x0F;
+                _remaining = 2;
+            } else {
+                _codePoint = lead & 0x07;
+                _remaining = 3;
+            }
+            // exclude overlong forms, surrogates and code points above U+10FFFF
+            _lowerBound = (lead == 0xE0) ? 0xA0 : (lead == 0xF0) ? 0x90 : 0x80;
+            _upperBound = (lead == 0xED) ? 0x9F : (lead == 0xF4) ? 0x8F : 0xBF;
+            continue;
+        }
+
+        const unsigned char byte = *in;
+        if (byte < _lowerBound || byte > _upperBound) {
+            // truncated sequence, the offending byte starts over
+            *out++ = REPLACEMENT_CHARACTER;
+            _remaining = 0;
+            continue;
+        }
+        ++in;
+        _lowerBound = 0x80;
+        _upperBound = 0xBF;
+        _codePoint = (_codePoint << 6) | (byte & 0x3F);
+        if (--_remaining == 0)
+            out = appendCodePoint(out, _codePoint);
+    }
+
+    return static_cast<int>(out - output);
+}
@@ -0,0 +1,78 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef UTF8DECODER_H
+#define UTF8DECODER_H
+
+namespace Konsole
+{
+
+/**
+ * Incremental UTF-8 decoder used by the emulation to turn the bytes
+ * received from the terminal process into unicode characters.
+ *
+ * The decoder keeps its state between calls to decode(), so multi-byte
+ * sequences which are split across two blocks of output are decoded
+ * correctly. Malformed input is replaced with U+FFFD, one replacement
+ * character per maximal invalid subpart as recommended by the Unicode
+ * standard.
+ *
+ * Characters are produced as UTF-32 code points, so unlike the previous
+ * QString based conversion there is no round trip through UTF-16
+ * surrogate pairs (except on platforms where wchar_t is 16 bits wide).
+ * Runs of plain ASCII, which make up almost all terminal output, are
+ * detected 16 bytes at a time and copied through without going through
+ * the state machine.
+ */
+class Utf8Decoder
+{
+public:
+    Utf8Decoder();
+
+    /** Discards any partially decoded multi-byte sequence. */
+    void reset();
+
+    /** Returns true if the last call to decode() ended in the middle of a sequence. */
+    bool hasPendingSequence() const { return _remaining != 0; }
+
+    /**
+     * Returns the size of the output buffer needed by decode() for
+     * @p length bytes of input.
+     */
+    static int maxOutputLength(int length) { return length + 1; }
+
+    /**
+     * Decodes @p length bytes from @p text and writes the resulting characters
+     * to @p output, which must have room for maxOutputLength(@p length)
+     * characters.
+     *
+     * @return The number of characters written to @p output.
+     */
+    int decode(const char* text, int length, wchar_t* output);
+
+private:
+    char32_t _codePoint;
+    int _remaining;          // continuation bytes still expected
+    unsigned char _lowerBound; // valid range for the next continuation byte
+    unsigned char _upperBound;
+};
+
+}
+
+#endif // UTF8DECODER_H
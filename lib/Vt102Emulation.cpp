@@ -28,6 +28,7 @@
 #include <cstdio>
 
 // Qt
+#include <QDataStream>
 #include <QEvent>
 #include <QKeyEvent>
 #include <QDebug>
@@ -42,6 +43,7 @@ using namespace Konsole;
 Vt102Emulation::Vt102Emulation()
     : Emulation(),
      prevCC(0),
+     _parserType(TokenizerParser),
      _titleUpdateTimer(new QTimer(this)),
      _reportFocusEvents(false),
      _toUtf8(QStringEncoder::Utf8)
@@ -66,6 +68,8 @@ void Vt102Emulation::clearEntireScreen()
 void Vt102Emulation::reset()
 {
   resetTokenizer();
+  _parser.reset();
+  endSynchronizedUpdate();
   resetModes();
   resetCharset(0);
   _screen[0]->reset();
@@ -75,6 +79,56 @@ void Vt102Emulation::reset()
   bufferedUpdate();
 }
 
+void Vt102Emulation::saveState(QDataStream& stream) const
+{
+  Emulation::saveState(stream);
+
+  for (int i = 0; i < MODE_total; i++)
+    stream << _currentModes.mode[i] << _savedModes.mode[i];
+  for (const CharCodes& charset : _charset)
+  {
+    stream.writeRawData(charset.charset, 4);
+    stream << qint32(charset.cu_cs) << charset.graphic << charset.pound
+           << charset.sa_graphic << charset.sa_pound;
+  }
+  stream << _reportFocusEvents;
+}
+
+bool Vt102Emulation::restoreState(QDataStream& stream)
+{
+  if (!Emulation::restoreState(stream))
+    return false;
+
+  for (int i = 0; i < MODE_total; i++)
+    stream >> _currentModes.mode[i] >> _savedModes.mode[i];
+  for (CharCodes& charset : _charset)
+  {
+    qint32 current = 0;
+    stream.readRawData(charset.charset, 4);
+    stream >> current >> charset.graphic >> charset.pound
+           >> charset.sa_graphic >> charset.sa_pound;
+    charset.cu_cs = current & 3;
+  }
+  stream >> _reportFocusEvents;
+
+  resetTokenizer();
+  _parser.reset();
+
+  // let the views know about the restored modes
+  emit programUsesMouseChanged(!(getMode(MODE_Mouse1000) || getMode(MODE_Mouse1001)
+                                 || getMode(MODE_Mouse1002) || getMode(MODE_Mouse1003)));
+  emit programBracketedPasteModeChanged(getMode(MODE_BracketedPaste));
+
+  return stream.status() == QDataStream::Ok;
+}
+
+bool Vt102Emulation::hasPendingSequence() const
+{
+  if (Emulation::hasPendingSequence())
+    return true;
+  return _parserType == StateMachineParser ? !_parser.isGround() : tokenBufferPos != 0;
+}
+
 /* ------------------------------------------------------------------------- */
 /*                                                                           */
 /*                     Processing the incoming byte stream                   */
@@ -261,9 +315,29 @@ void Vt102Emulation::initTokenizer()
 #define ESC 27
 #define DEL 127
 
+void Vt102Emulation::setParserType(ParserType type)
+{
+  if (_parserType == type)
+    return;
+  _parserType = type;
+  resetTokenizer();
+  _parser.reset();
+}
+
+Vt102Emulation::ParserType Vt102Emulation::parserType() const
+{
+  return _parserType;
+}
+
 // process an incoming unicode character
 void Vt102Emulation::receiveChar(wchar_t cc)
 {
+  if (_parserType == StateMachineParser && getMode(MODE_Ansi))
+  {
+    receiveCharWithParser(cc);
+    return;
+  }
+
   if (cc == DEL)
     return; //VT100: ignore.
 
@@ -299,7 +373,7 @@ void Vt102Emulation::receiveChar(wchar_t cc)
     if (lec(1,0,ESC)) { return; }
     if (lec(1,0,ESC+128)) { s[0] = ESC; receiveChar('['); return; }
     if (les(2,1,GRP)) { return; }
-    if (Xte         ) { processWindowAttributeChange(); resetTokenizer(); return; }
+    if (Xte         ) { processWindowAttributeChange(tokenBuffer + 2, tokenBufferPos - 3); resetTokenizer(); return; }
     if (Xpe         ) { prevCC = cc; return; }
     if (lec(3,2,'?')) { return; }
     if (lec(3,2,'>')) { return; }
@@ -327,28 +401,7 @@ void Vt102Emulation::receiveChar(wchar_t cc)
     if (epe(   )) { processToken( TY_CSI_PE(cc), 0, 0); resetTokenizer(); return; }
     if (ees(DIG)) { addDigit(cc-'0'); return; }
     if (eec(';') || eec(':')) { addArgument(); return; }
-    for (int i=0;i<=argc;i++)
-    {
-        if (epp())
-            processToken( TY_CSI_PR(cc,argv[i]), 0, 0);
-        else if (egt())
-            processToken( TY_CSI_PG(cc), 0, 0); // spec. case for ESC]>0c or ESC]>c
-        else if (cc == 'm' && argc - i >= 4 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 2)
-        {
-            // ESC[ ... 48;2;<red>;<green>;<blue> ... m -or- ESC[ ... 38;2;<red>;<green>;<blue> ... m
-            i += 2;
-            processToken( TY_CSI_PS(cc, argv[i-2]), COLOR_SPACE_RGB, (argv[i] << 16) | (argv[i+1] << 8) | argv[i+2]);
-            i += 2;
-        }
-        else if (cc == 'm' && argc - i >= 2 && (argv[i] == 38 || argv[i] == 48) && argv[i+1] == 5)
-        {
-            // ESC[ ... 48;5;<index> ... m -or- ESC[ ... 38;5;<index> ... m
-            i += 2;
-            processToken( TY_CSI_PS(cc, argv[i-2]), COLOR_SPACE_256, argv[i]);
-        }
-        else
-            processToken( TY_CSI_PS(cc,argv[i]), 0, 0);
-    }
+    processCsiParameters(cc, epp() ? '?' : egt() ? '>' : 0, argv, argc + 1);
     resetTokenizer();
   }
   else
@@ -377,29 +430,404 @@ void Vt102Emulation::receiveChar(wchar_t cc)
     return;
   }
 }
-void Vt102Emulation::processWindowAttributeChange()
+// Characters which, outside of an escape sequence, are simply displayed:
+// everything but C0 controls, DEL and C1 controls (0x9b is an 8-bit CSI).
+static inline bool isPlainPrintable(wchar_t cc)
+{
+  return cc >= 32 && cc != DEL && (cc < 0x80 || cc >= 0xa0);
+}
+
+// Printable ASCII, which is never translated, combined or wide.
+static inline bool isPlainAscii(wchar_t cc)
+{
+  return cc >= 32 && cc < DEL;
+}
+
+// process a block of incoming unicode characters
+void Vt102Emulation::receiveChars(const wchar_t* text, int length)
+{
+  int i = 0;
+  while (i < length)
+  {
+    // Runs of plain printable characters seen in the ground state, with
+    // no VT100 charset translation in effect, are handed to the screen
+    // as a whole instead of being tokenized one by one.
+    const CharCodes& charset = _charset[_currentScreen == _screen[1]];
+    const bool ground = (_parserType == StateMachineParser) ? _parser.isGround() : tokenBufferPos == 0;
+    if (!ground || !getMode(MODE_Ansi) || charset.graphic || charset.pound)
+    {
+      receiveChar(text[i++]);
+      continue;
+    }
+
+    // Consecutive lines of plain ASCII ended by CR LF, as written by
+    // 'cat' and most log output, go to the screen together so that the
+    // rows scrolling off before the end of the block are moved to the
+    // history in one go.
+    _lineStarts.clear();
+    _lineLengths.clear();
+    int lineEnd = i;
+    for (;;)
+    {
+      const int lineStart = lineEnd;
+      while (lineEnd < length && isPlainAscii(text[lineEnd]))
+        lineEnd++;
+      if (lineEnd + 1 >= length || text[lineEnd] != '\r' || text[lineEnd + 1] != '\n')
+        break;
+      _lineStarts << lineStart;
+      _lineLengths << lineEnd - lineStart;
+      lineEnd += 2;
+    }
+    if (_lineStarts.size() > 1)
+    {
+      _currentScreen->displayLines(text, _lineStarts.constData(), _lineLengths.constData(), int(_lineStarts.size()));
+      i = _lineStarts.last() + _lineLengths.last() + 2;
+      continue;
+    }
+
+    if (isPlainPrintable(text[i]))
+    {
+      int end = i + 1;
+      while (end < length && isPlainPrintable(text[end]))
+        end++;
+      _currentScreen->displayString(text + i, end - i);
+      i = end;
+      continue;
+    }
+    receiveChar(text[i++]);
+  }
+}
+
+// Maps the sequences recognized by VtParser to the same tokens the
+// tokenizer above produces, so both share processToken().
+void Vt102Emulation::receiveCharWithParser(wchar_t cc)
+{
+  switch (_parser.advance(cc))
+  {
+    case VtParser::Print:
+      processToken( TY_CHR(), applyCharset(cc), 0);
+      break;
+    case VtParser::Execute:
+      processToken( TY_CTL(cc+'@'), 0, 0);
+      break;
+    case VtParser::EscDispatch:
+      processParserEscape();
+      break;
+    case VtParser::CsiDispatch:
+      processParserCsi();
+      break;
+    case VtParser::OscDispatch:
+      processWindowAttributeChange(_parser.oscData(), _parser.oscLength());
+      break;
+    case VtParser::NoAction:
+      break;
+  }
+}
+
+// Sequence dispatch ----------------------------------------------------------
+
+/*
+   The escape and control sequences recognized by VtParser are looked up
+   in two tables, indexed by the final character of the sequence and its
+   kind, i.e. the intermediate character or private marker preceding it.
+   The tables are filled at compile time; sequences without an entry are
+   ignored.  Most handlers map the sequence onto the tokens also produced
+   by the tokenizer, so both parsers share processToken().
+*/
+
+static constexpr int escapeIndex(wchar_t cc, int kind)
+{
+  return kind * (0x7f - 0x30) + (cc - 0x30);
+}
+
+static constexpr int csiIndex(wchar_t cc, int kind)
+{
+  return kind * (0x7f - 0x40) + (cc - 0x40);
+}
+
+constexpr Vt102Emulation::EscapeTable Vt102Emulation::buildEscapeTable()
+{
+  EscapeTable table{};
+  for (const char* s = "DEHMZcno78=><"; *s; ++s)
+    table[escapeIndex(*s, EscPlain)] = &Vt102Emulation::escapeSimple;
+  for (const char* s = "0AB@G"; *s; ++s)
+    table[escapeIndex(*s, EscDesignate)] = &Vt102Emulation::escapeDesignateCharset;
+  for (const char* s = "34568"; *s; ++s)
+    table[escapeIndex(*s, EscLineAttribute)] = &Vt102Emulation::escapeLineAttribute;
+  return table;
+}
+
+constexpr Vt102Emulation::CsiTable Vt102Emulation::buildCsiTable()
+{
+  CsiTable table{};
+  for (const char* s = "@ABCDEFGHILMPSTXZbcdfry"; *s; ++s)
+    table[csiIndex(*s, CsiPlain)] = &Vt102Emulation::csiNumeric;
+  for (const char* s = "JKghilnqsux"; *s; ++s)
+    table[csiIndex(*s, CsiPlain)] = &Vt102Emulation::csiSelective;
+  table[csiIndex('t', CsiPlain)] = &Vt102Emulation::csiWindowOperation;
+  table[csiIndex('m', CsiPlain)] = &Vt102Emulation::csiGraphicRendition;
+  for (const char* s = "hlrs"; *s; ++s)
+    table[csiIndex(*s, CsiPrivate)] = &Vt102Emulation::csiPrivateMode;
+  table[csiIndex('c', CsiSecondary)] = &Vt102Emulation::csiSecondaryAttributes;
+  table[csiIndex('q', CsiSpace)] = &Vt102Emulation::csiCursorStyle;
+  table[csiIndex('p', CsiBang)] = &Vt102Emulation::csiSoftReset;
+  return table;
+}
+
+const Vt102Emulation::EscapeTable Vt102Emulation::_escapeHandlers = Vt102Emulation::buildEscapeTable();
+const Vt102Emulation::CsiTable Vt102Emulation::_csiHandlers = Vt102Emulation::buildCsiTable();
+
+void Vt102Emulation::processParserEscape()
+{
+  const wchar_t cc = _parser.character();
+  if (cc < 0x30 || cc > 0x7e)
+    return;
+
+  int kind;
+  if (_parser.intermediateCount() == 0)
+    kind = EscPlain;
+  else if (_parser.intermediateCount() > 1)
+    return;
+  else if (_parser.intermediate(0) == '#')
+    kind = EscLineAttribute;
+  else if ((charClass[(quint8)_parser.intermediate(0)] & SCS) == SCS)
+    kind = EscDesignate;
+  else
+    return;
+
+  if (const SequenceHandler handler = _escapeHandlers[escapeIndex(cc, kind)])
+    (this->*handler)();
+}
+
+void Vt102Emulation::processParserCsi()
+{
+  const wchar_t cc = _parser.character();
+  if (cc < 0x40 || cc > 0x7e)
+    return;
+
+  int kind;
+  if (_parser.intermediateCount() == 0)
+  {
+    switch (_parser.privateMarker())
+    {
+      case 0   : kind = CsiPlain;     break;
+      case '?' : kind = CsiPrivate;   break;
+      case '>' : kind = CsiSecondary; break;
+      default  : return;
+    }
+  }
+  else if (_parser.intermediateCount() == 1 && !_parser.privateMarker())
+  {
+    switch (_parser.intermediate(0))
+    {
+      case ' ' : kind = CsiSpace; break;
+      case '!' : kind = CsiBang;  break;
+      default  : return;
+    }
+  }
+  else
+    return;
+
+  if (const SequenceHandler handler = _csiHandlers[csiIndex(cc, kind)])
+    (this->*handler)();
+}
+
+// ESC <final>
+void Vt102Emulation::escapeSimple()
+{
+  processToken( TY_ESC(_parser.character()), 0, 0);
+}
+
+// ESC ( <final> and friends: designate a character set
+void Vt102Emulation::escapeDesignateCharset()
+{
+  processToken( TY_ESC_CS(_parser.intermediate(0), _parser.character()), 0, 0);
+}
+
+// ESC # <final>
+void Vt102Emulation::escapeLineAttribute()
+{
+  processToken( TY_ESC_DE(_parser.character()), 0, 0);
+}
+
+// CSI <n> ; <m> <final>
+void Vt102Emulation::csiNumeric()
+{
+  processToken( TY_CSI_PN(_parser.character()), _parser.parameter(0), _parser.parameter(1));
+}
+
+// CSI <ps> ; ... <final>, one action per parameter
+void Vt102Emulation::csiSelective()
+{
+  processCsiParameters(_parser.character(), 0, _parser.parameters(), _parser.parameterCount());
+}
+
+// CSI <ps> ; <p1> ; <p2> t
+void Vt102Emulation::csiWindowOperation()
+{
+  processToken( TY_CSI_PS('t', _parser.parameter(0)), _parser.parameter(1), _parser.parameter(2));
+}
+
+// CSI <ps> ; ... m
+void Vt102Emulation::csiGraphicRendition()
+{
+  processGraphicRendition(_parser.parameters(), _parser.parameterCount());
+}
+
+// CSI ? <ps> ; ... <final>
+void Vt102Emulation::csiPrivateMode()
+{
+  processCsiParameters(_parser.character(), '?', _parser.parameters(), _parser.parameterCount());
+}
+
+// CSI > <ps> c
+void Vt102Emulation::csiSecondaryAttributes()
+{
+  processCsiParameters(_parser.character(), '>', _parser.parameters(), _parser.parameterCount());
+}
+
+// CSI <ps> SP q
+void Vt102Emulation::csiCursorStyle()
+{
+  processToken( TY_CSI_PS_SP('q', _parser.parameter(0)), _parser.parameter(0), 0);
+}
+
+// CSI ! p
+void Vt102Emulation::csiSoftReset()
+{
+  processToken( TY_CSI_PE('p'), 0, 0);
+}
+
+// Dispatches the parameters of a CSI sequence ending in cc, one token per
+// parameter. marker is the private marker ('?' or '>') or 0.
+void Vt102Emulation::processCsiParameters(wchar_t cc, wchar_t marker, const int* args, int count)
+{
+    if (cc == 'm' && !marker)
+    {
+        processGraphicRendition(args, count);
+        return;
+    }
+
+    for (int i=0;i<count;i++)
+    {
+        if (marker == '?')
+            processToken( TY_CSI_PR(cc,args[i]), 0, 0);
+        else if (marker == '>')
+            processToken( TY_CSI_PG(cc), 0, 0); // spec. case for ESC]>0c or ESC]>c
+        else
+            processToken( TY_CSI_PS(cc,args[i]), 0, 0);
+    }
+}
+
+// Reads an extended color following 38 or 48 at args[i], i.e. either
+// "2;<red>;<green>;<blue>" or "5;<index>", and advances i past it.
+static CharacterColor extendedColor(const int* args, int count, int& i)
+{
+    if (count - 1 - i >= 4 && args[i+1] == 2)
+    {
+        // ESC[ ... 48;2;<red>;<green>;<blue> ... m -or- ESC[ ... 38;2;<red>;<green>;<blue> ... m
+        i += 4;
+        return CharacterColor(COLOR_SPACE_RGB, (args[i-2] << 16) | (args[i-1] << 8) | args[i]);
+    }
+    if (count - 1 - i >= 2 && args[i+1] == 5)
+    {
+        // ESC[ ... 48;5;<index> ... m -or- ESC[ ... 38;5;<index> ... m
+        i += 2;
+        return CharacterColor(COLOR_SPACE_256, args[i]);
+    }
+    // invalid, replaced by the default color
+    return CharacterColor();
+}
+
+// Applies all attributes of a "CSI ... m" sequence to the current screen,
+// which updates its effective rendition only once.
+void Vt102Emulation::processGraphicRendition(const int* args, int count)
+{
+    int rendition;
+    CharacterColor foreground;
+    CharacterColor background;
+    _currentScreen->getRendition(rendition, foreground, background);
+
+    for (int i=0;i<count;i++)
+    {
+        const int attribute = args[i];
+        switch (attribute)
+        {
+        case   0 : rendition  = DEFAULT_RENDITION;
+                   foreground = CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_FORE_COLOR);
+                   background = CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_BACK_COLOR); break;
+        case   1 : rendition |=  RE_BOLD;                         break; //VT100
+        case   2 : rendition |=  RE_FAINT;                        break;
+        case   3 : rendition |=  RE_ITALIC;                       break; //VT100
+        case   4 : rendition |=  RE_UNDERLINE;                    break; //VT100
+        case   5 : rendition |=  RE_BLINK;                        break; //VT100
+        case   7 : rendition |=  RE_REVERSE;                      break;
+        case   8 : rendition |=  RE_CONCEAL;                      break;
+        case   9 : rendition |=  RE_STRIKEOUT;                    break;
+        case  53 : rendition |=  RE_OVERLINE;                     break;
+        case  10 : /* IGNORED: mapping related */                 break; //LINUX
+        case  11 : /* IGNORED: mapping related */                 break; //LINUX
+        case  12 : /* IGNORED: mapping related */                 break; //LINUX
+        case  21 : rendition &= ~RE_BOLD;                         break;
+        case  22 : rendition &= ~(RE_BOLD | RE_FAINT);            break;
+        case  23 : rendition &= ~RE_ITALIC;                       break; //VT100
+        case  24 : rendition &= ~RE_UNDERLINE;                    break;
+        case  25 : rendition &= ~RE_BLINK;                        break;
+        case  27 : rendition &= ~RE_REVERSE;                      break;
+        case  28 : rendition &= ~RE_CONCEAL;                      break;
+        case  29 : rendition &= ~RE_STRIKEOUT;                    break;
+        case  55 : rendition &= ~RE_OVERLINE;                     break;
+
+        case  30 : case  31 : case  32 : case  33 :
+        case  34 : case  35 : case  36 : case  37 :
+                   foreground = CharacterColor(COLOR_SPACE_SYSTEM, attribute - 30);     break;
+        case  38 : foreground = extendedColor(args, count, i);                         break;
+        case  39 : foreground = CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_FORE_COLOR); break;
+
+        case  40 : case  41 : case  42 : case  43 :
+        case  44 : case  45 : case  46 : case  47 :
+                   background = CharacterColor(COLOR_SPACE_SYSTEM, attribute - 40);     break;
+        case  48 : background = extendedColor(args, count, i);                         break;
+        case  49 : background = CharacterColor(COLOR_SPACE_DEFAULT, DEFAULT_BACK_COLOR); break;
+
+        case  90 : case  91 : case  92 : case  93 :
+        case  94 : case  95 : case  96 : case  97 :
+                   foreground = CharacterColor(COLOR_SPACE_SYSTEM, attribute - 90 + 8); break;
+
+        case 100 : case 101 : case 102 : case 103 :
+        case 104 : case 105 : case 106 : case 107 :
+                   background = CharacterColor(COLOR_SPACE_SYSTEM, attribute - 100 + 8); break;
+
+        default  : break;
+        }
+    }
+
+    _currentScreen->setRendition(rendition, foreground, background);
+}
+
+// The payload of an OSC sequence, i.e. everything between "ESC ]" and the
+// terminating BEL or ST.
+void Vt102Emulation::processWindowAttributeChange(const wchar_t* payload, int length)
 {
   // Describes the window or terminal session attribute to change
   // See Session::UserTitleChange for possible values
   int attributeToChange = 0;
   int i;
-  for (i = 2; i < tokenBufferPos     &&
-              tokenBuffer[i] >= '0'  &&
-              tokenBuffer[i] <= '9'; i++)
+  for (i = 0; i < length      &&
+              payload[i] >= '0'  &&
+              payload[i] <= '9'; i++)
   {
-    attributeToChange = 10 * attributeToChange + (tokenBuffer[i]-'0');
+    attributeToChange = 10 * attributeToChange + (payload[i]-'0');
   }
 
-  if (tokenBuffer[i] != ';')
+  if (i >= length || payload[i] != ';')
   {
     reportDecodingError();
     return;
   }
 
-  // copy from the first char after ';', and skipping the ending delimiter
-  // 0x07 or 0x92. Note that as control characters in OSC text parts are
-  // ignored, only the second char in ST ("\e\\") is appended to tokenBuffer.
-  QString newValue = QString::fromWCharArray(tokenBuffer + i + 1, tokenBufferPos-i-2);
+  // copy from the first char after ';'
+  QString newValue = QString::fromWCharArray(payload + i + 1, length - i - 1);
 
   _pendingTitleUpdates[attributeToChange] = newValue;
   _titleUpdateTimer->start(20);
@@ -556,73 +984,7 @@ void Vt102Emulation::processToken(int token, wchar_t p, int q)
     case TY_CSI_PS('s',   0) :      saveCursor           (          ); break;
     case TY_CSI_PS('u',   0) :      restoreCursor        (          ); break;
 
-    case TY_CSI_PS('m',   0) : _currentScreen->setDefaultRendition  (          ); break;
-    case TY_CSI_PS('m',   1) : _currentScreen->  setRendition     (RE_BOLD     ); break; //VT100
-    case TY_CSI_PS('m',   2) : _currentScreen->  setRendition     (RE_FAINT    ); break;
-    case TY_CSI_PS('m',   3) : _currentScreen->  setRendition     (RE_ITALIC   ); break; //VT100
-    case TY_CSI_PS('m',   4) : _currentScreen->  setRendition     (RE_UNDERLINE); break; //VT100
-    case TY_CSI_PS('m',   5) : _currentScreen->  setRendition     (RE_BLINK    ); break; //VT100
-    case TY_CSI_PS('m',   7) : _currentScreen->  setRendition     (RE_REVERSE  ); break;
-    case TY_CSI_PS('m',   8) : _currentScreen->  setRendition     (RE_CONCEAL  ); break;
-    case TY_CSI_PS('m',   9) : _currentScreen->  setRendition     (RE_STRIKEOUT); break;
-    case TY_CSI_PS('m',  53) : _currentScreen->  setRendition     (RE_OVERLINE ); break;
-    case TY_CSI_PS('m',  10) : /* IGNORED: mapping related          */ break; //LINUX
-    case TY_CSI_PS('m',  11) : /* IGNORED: mapping related          */ break; //LINUX
-    case TY_CSI_PS('m',  12) : /* IGNORED: mapping related          */ break; //LINUX
-    case TY_CSI_PS('m',  21) : _currentScreen->resetRendition     (RE_BOLD     ); break;
-    case TY_CSI_PS('m',  22) : _currentScreen->resetRendition     (RE_BOLD     );
-                               _currentScreen->resetRendition     (RE_FAINT    ); break;
-    case TY_CSI_PS('m',  23) : _currentScreen->resetRendition     (RE_ITALIC   ); break; //VT100
-    case TY_CSI_PS('m',  24) : _currentScreen->resetRendition     (RE_UNDERLINE); break;
-    case TY_CSI_PS('m',  25) : _currentScreen->resetRendition     (RE_BLINK    ); break;
-    case TY_CSI_PS('m',  27) : _currentScreen->resetRendition     (RE_REVERSE  ); break;
-    case TY_CSI_PS('m',  28) : _currentScreen->resetRendition     (RE_CONCEAL  ); break;
-    case TY_CSI_PS('m',  29) : _currentScreen->resetRendition     (RE_STRIKEOUT); break;
-    case TY_CSI_PS('m',  55) : _currentScreen->resetRendition     (RE_OVERLINE ); break;
-
-    case TY_CSI_PS('m',   30) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  0); break;
-    case TY_CSI_PS('m',   31) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  1); break;
-    case TY_CSI_PS('m',   32) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  2); break;
-    case TY_CSI_PS('m',   33) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  3); break;
-    case TY_CSI_PS('m',   34) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  4); break;
-    case TY_CSI_PS('m',   35) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  5); break;
-    case TY_CSI_PS('m',   36) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  6); break;
-    case TY_CSI_PS('m',   37) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  7); break;
-
-    case TY_CSI_PS('m',   38) : _currentScreen->setForeColor         (p,       q); break;
-
-    case TY_CSI_PS('m',   39) : _currentScreen->setForeColor         (COLOR_SPACE_DEFAULT,  0); break;
-
-    case TY_CSI_PS('m',   40) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  0); break;
-    case TY_CSI_PS('m',   41) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  1); break;
-    case TY_CSI_PS('m',   42) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  2); break;
-    case TY_CSI_PS('m',   43) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  3); break;
-    case TY_CSI_PS('m',   44) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  4); break;
-    case TY_CSI_PS('m',   45) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  5); break;
-    case TY_CSI_PS('m',   46) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  6); break;
-    case TY_CSI_PS('m',   47) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  7); break;
-
-    case TY_CSI_PS('m',   48) : _currentScreen->setBackColor         (p,       q); break;
-
-    case TY_CSI_PS('m',   49) : _currentScreen->setBackColor         (COLOR_SPACE_DEFAULT,  1); break;
-
-    case TY_CSI_PS('m',   90) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  8); break;
-    case TY_CSI_PS('m',   91) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM,  9); break;
-    case TY_CSI_PS('m',   92) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM, 10); break;
-    case TY_CSI_PS('m',   93) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM, 11); break;
-    case TY_CSI_PS('m',   94) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM, 12); break;
-    case TY_CSI_PS('m',   95) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM, 13); break;
-    case TY_CSI_PS('m',   96) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM, 14); break;
-    case TY_CSI_PS('m',   97) : _currentScreen->setForeColor         (COLOR_SPACE_SYSTEM, 15); break;
-
-    case TY_CSI_PS('m',  100) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  8); break;
-    case TY_CSI_PS('m',  101) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM,  9); break;
-    case TY_CSI_PS('m',  102) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM, 10); break;
-    case TY_CSI_PS('m',  103) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM, 11); break;
-    case TY_CSI_PS('m',  104) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM, 12); break;
-    case TY_CSI_PS('m',  105) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM, 13); break;
-    case TY_CSI_PS('m',  106) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM, 14); break;
-    case TY_CSI_PS('m',  107) : _currentScreen->setBackColor         (COLOR_SPACE_SYSTEM, 15); break;
+    // SGR ('m') is applied as a whole by processGraphicRendition()
 
     case TY_CSI_PS('n',   5) :      reportStatus         (          ); break;
     case TY_CSI_PS('n',   6) :      reportCursorPosition (          ); break;
@@ -805,6 +1167,9 @@ void Vt102Emulation::processToken(int token, wchar_t p, int q)
     case TY_CSI_PR('s', 2004) :         saveMode      (MODE_BracketedPaste); break; //XTERM
     case TY_CSI_PR('r', 2004) :      restoreMode      (MODE_BracketedPaste); break; //XTERM
 
+    case TY_CSI_PR('h', 2026) : beginSynchronizedUpdate(); break; // synchronized output
+    case TY_CSI_PR('l', 2026) :   endSynchronizedUpdate(); break;
+
     //FIXME: weird DEC reset sequence
     case TY_CSI_PE('p'      ) : /* IGNORED: reset         (        ) */ break;
 
@@ -1137,6 +1502,16 @@ void Vt102Emulation::sendKeyEvent(QKeyEvent* event, bool fromPaste)
 
 #define CHARSET _charset[_currentScreen==_screen[1]]
 
+// assert for i in [0..31] : vt100extended(vt100_graphics[i]) == i.
+
+unsigned short Konsole::vt100_graphics[32] =
+{ // 0/8     1/9    2/10    3/11    4/12    5/13    6/14    7/15
+  0x0020, 0x25C6, 0x2592, 0x2409, 0x240c, 0x240d, 0x240a, 0x00b0,
+  0x00b1, 0x2424, 0x240b, 0x2518, 0x2510, 0x250c, 0x2514, 0x253c,
+  0xF800, 0xF801, 0x2500, 0xF803, 0xF804, 0x251c, 0x2524, 0x2534,
+  0x252c, 0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00b7
+};
+
 // Apply current character map.
 
 wchar_t Vt102Emulation::applyCharset(wchar_t c)
@@ -24,16 +24,19 @@
 #define VT102EMULATION_H
 
 // Standard Library
+#include <array>
 #include <cstdio>
 
 // Qt
 #include <QKeyEvent>
 #include <QHash>
 #include <QTimer>
+#include <QStringEncoder>
 
 // Konsole
 #include "Emulation.h"
 #include "Screen.h"
+#include "VtParser.h"
 
 #define MODE_AppScreen       (MODES_SCREEN+0)   // Mode #1
 #define MODE_AppCuKeys       (MODES_SCREEN+1)   // Application cursor keys (DECCKM)
@@ -75,7 +78,7 @@ struct CharCodes
  * sequences.
  *
  */
-class Vt102Emulation : public Emulation
+class QTERMWIDGET_CORE_EXPORT Vt102Emulation : public Emulation
 {
 Q_OBJECT
 
@@ -84,10 +87,36 @@ public:
   Vt102Emulation();
   ~Vt102Emulation() override;
 
+  /** Selects how the incoming character stream is split into escape sequences */
+  enum ParserType
+  {
+    /**
+     * The original tokenizer which deduces its state from the characters
+     * of the current sequence collected so far.
+     */
+    TokenizerParser,
+    /**
+     * The table driven DEC/ANSI state machine, see VtParser. It handles
+     * parameters and OSC strings of any length in linear time.
+     */
+    StateMachineParser
+  };
+
+  /**
+   * Sets the parser used for the incoming character stream. Any partially
+   * received escape sequence is discarded. VT52 mode is always handled by
+   * the tokenizer.
+   */
+  void setParserType(ParserType type);
+  ParserType parserType() const;
+
   // reimplemented from Emulation
   void clearEntireScreen() override;
   void reset() override;
   char eraseChar() const override;
+  void saveState(QDataStream& stream) const override;
+  bool restoreState(QDataStream& stream) override;
+  bool hasPendingSequence() const override;
 
 public slots:
   // reimplemented from Emulation
@@ -103,6 +132,7 @@ protected:
   void setMode(int mode) override;
   void resetMode(int mode) override;
   void receiveChar(wchar_t cc) override;
+  void receiveChars(const wchar_t* text, int length) override;
 
 private slots:
   //causes changeTitle() to be emitted for each (int,QString) pair in pendingTitleUpdates
@@ -153,7 +183,40 @@ private:
   void reportDecodingError();
 
   void processToken(int code, wchar_t p, int q);
-  void processWindowAttributeChange();
+  void processCsiParameters(wchar_t cc, wchar_t marker, const int* args, int count);
+  void processGraphicRendition(const int* args, int count);
+  void processWindowAttributeChange(const wchar_t* payload, int length);
+
+  // feeds a character to _parser and dispatches the result
+  void receiveCharWithParser(wchar_t cc);
+  void processParserEscape();
+  void processParserCsi();
+
+  // Handlers for the sequences recognized by _parser, looked up by the
+  // final character and the kind of intermediate or private marker.
+  // New sequences are registered in buildEscapeTable() and buildCsiTable().
+  typedef void (Vt102Emulation::*SequenceHandler)();
+  enum EscapeKind { EscPlain, EscDesignate, EscLineAttribute, EscapeKindCount };
+  enum CsiKind { CsiPlain, CsiPrivate, CsiSecondary, CsiSpace, CsiBang, CsiKindCount };
+  // final characters are 0x30..0x7e for ESC and 0x40..0x7e for CSI sequences
+  typedef std::array<SequenceHandler, (0x7f - 0x30) * EscapeKindCount> EscapeTable;
+  typedef std::array<SequenceHandler, (0x7f - 0x40) * CsiKindCount> CsiTable;
+  static constexpr EscapeTable buildEscapeTable();
+  static constexpr CsiTable buildCsiTable();
+  static const EscapeTable _escapeHandlers;
+  static const CsiTable _csiHandlers;
+
+  void escapeSimple();
+  void escapeDesignateCharset();
+  void escapeLineAttribute();
+  void csiNumeric();
+  void csiSelective();
+  void csiWindowOperation();
+  void csiGraphicRendition();
+  void csiPrivateMode();
+  void csiSecondaryAttributes();
+  void csiCursorStyle();
+  void csiSoftReset();
   void requestWindowAttribute(int);
 
   void reportTerminalType();
@@ -170,6 +233,13 @@ private:
   // number of columns
   void clearScreenAndSetColumns(int columnCount);
 
+  VtParser _parser;
+  ParserType _parserType;
+
+  // the complete lines found by receiveChars(), see Screen::displayLines()
+  QVector<int> _lineStarts;
+  QVector<int> _lineLengths;
+
   CharCodes _charset[2];
 
   class TerminalState
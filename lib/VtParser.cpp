@@ -0,0 +1,282 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "VtParser.h"
+
+using namespace Konsole;
+
+namespace
+{
+
+// Actions attached to a transition
+enum Action
+{
+    NoOp,
+    IgnoreChar,
+    PrintChar,
+    ExecuteChar,
+    CollectChar,
+    AddParam,
+    DispatchEsc,
+    DispatchCsi,
+    PutOsc,
+    EndOsc,
+    PutDcs
+};
+
+// One column per character up to U+009F, everything above shares the last one
+const int TABLE_COLUMNS = 0xa1;
+
+// Table entries: bits 0-3 next state, bits 4-7 action, ENTER set if the
+// transition enters the next state (running its entry action) rather than
+// staying in the current one.
+const unsigned short ENTER = 0x100;
+
+struct TransitionTable
+{
+    unsigned short entries[VtParser::StateCount][TABLE_COLUMNS];
+};
+
+constexpr unsigned short enter(Action action, VtParser::State state)
+{
+    return ENTER | (action << 4) | state;
+}
+
+constexpr unsigned short stay(Action action, VtParser::State state)
+{
+    return (action << 4) | state;
+}
+
+constexpr void setRange(TransitionTable& table, VtParser::State state, int from, int to, unsigned short entry)
+{
+    for (int c = from; c <= to; c++)
+        table.entries[state][c] = entry;
+}
+
+constexpr void setExecuteC0(TransitionTable& table, VtParser::State state, Action action)
+{
+    setRange(table, state, 0x00, 0x17, stay(action, state));
+    setRange(table, state, 0x19, 0x19, stay(action, state));
+    setRange(table, state, 0x1c, 0x1f, stay(action, state));
+}
+
+constexpr TransitionTable buildTransitionTable()
+{
+    TransitionTable table{};
+
+    for (int s = 0; s < VtParser::StateCount; s++)
+        setRange(table, VtParser::State(s), 0, TABLE_COLUMNS - 1, stay(IgnoreChar, VtParser::State(s)));
+
+    // C0 controls are executed immediately, even within a sequence
+    setExecuteC0(table, VtParser::Ground, ExecuteChar);
+    setExecuteC0(table, VtParser::Escape, ExecuteChar);
+    setExecuteC0(table, VtParser::EscapeIntermediate, ExecuteChar);
+    setExecuteC0(table, VtParser::CsiEntry, ExecuteChar);
+    setExecuteC0(table, VtParser::CsiParam, ExecuteChar);
+    setExecuteC0(table, VtParser::CsiIntermediate, ExecuteChar);
+    setExecuteC0(table, VtParser::CsiIgnore, ExecuteChar);
+    setExecuteC0(table, VtParser::DcsPassthrough, PutDcs);
+
+    setRange(table, VtParser::Ground, 0x20, 0x7e, stay(PrintChar, VtParser::Ground));
+    setRange(table, VtParser::Ground, 0xa0, 0xa0, stay(PrintChar, VtParser::Ground));
+
+    setRange(table, VtParser::Escape, 0x20, 0x2f, enter(CollectChar, VtParser::EscapeIntermediate));
+    setRange(table, VtParser::Escape, 0x30, 0x7e, enter(DispatchEsc, VtParser::Ground));
+    setRange(table, VtParser::Escape, 'P', 'P', enter(NoOp, VtParser::DcsEntry));
+    setRange(table, VtParser::Escape, 'X', 'X', enter(NoOp, VtParser::SosPmApcString));
+    setRange(table, VtParser::Escape, '[', '[', enter(NoOp, VtParser::CsiEntry));
+    setRange(table, VtParser::Escape, ']', ']', enter(NoOp, VtParser::OscString));
+    setRange(table, VtParser::Escape, '^', '_', enter(NoOp, VtParser::SosPmApcString));
+
+    setRange(table, VtParser::EscapeIntermediate, 0x20, 0x2f, stay(CollectChar, VtParser::EscapeIntermediate));
+    setRange(table, VtParser::EscapeIntermediate, 0x30, 0x7e, enter(DispatchEsc, VtParser::Ground));
+
+    setRange(table, VtParser::CsiEntry, 0x20, 0x2f, enter(CollectChar, VtParser::CsiIntermediate));
+    setRange(table, VtParser::CsiEntry, 0x30, 0x3b, enter(AddParam, VtParser::CsiParam));
+    setRange(table, VtParser::CsiEntry, 0x3c, 0x3f, enter(CollectChar, VtParser::CsiParam));
+    setRange(table, VtParser::CsiEntry, 0x40, 0x7e, enter(DispatchCsi, VtParser::Ground));
+
+    setRange(table, VtParser::CsiParam, 0x20, 0x2f, enter(CollectChar, VtParser::CsiIntermediate));
+    setRange(table, VtParser::CsiParam, 0x30, 0x3b, stay(AddParam, VtParser::CsiParam));
+    setRange(table, VtParser::CsiParam, 0x3c, 0x3f, enter(NoOp, VtParser::CsiIgnore));
+    setRange(table, VtParser::CsiParam, 0x40, 0x7e, enter(DispatchCsi, VtParser::Ground));
+
+    setRange(table, VtParser::CsiIntermediate, 0x20, 0x2f, stay(CollectChar, VtParser::CsiIntermediate));
+    setRange(table, VtParser::CsiIntermediate, 0x30, 0x3f, enter(NoOp, VtParser::CsiIgnore));
+    setRange(table, VtParser::CsiIntermediate, 0x40, 0x7e, enter(DispatchCsi, VtParser::Ground));
+
+    setRange(table, VtParser::CsiIgnore, 0x40, 0x7e, enter(NoOp, VtParser::Ground));
+
+    setRange(table, VtParser::DcsEntry, 0x20, 0x2f, enter(CollectChar, VtParser::DcsIntermediate));
+    setRange(table, VtParser::DcsEntry, 0x30, 0x3b, enter(AddParam, VtParser::DcsParam));
+    setRange(table, VtParser::DcsEntry, 0x3a, 0x3a, enter(NoOp, VtParser::DcsIgnore));
+    setRange(table, VtParser::DcsEntry, 0x3c, 0x3f, enter(CollectChar, VtParser::DcsParam));
+    setRange(table, VtParser::DcsEntry, 0x40, 0x7e, enter(NoOp, VtParser::DcsPassthrough));
+
+    setRange(table, VtParser::DcsParam, 0x20, 0x2f, enter(CollectChar, VtParser::DcsIntermediate));
+    setRange(table, VtParser::DcsParam, 0x30, 0x3b, stay(AddParam, VtParser::DcsParam));
+    setRange(table, VtParser::DcsParam, 0x3a, 0x3a, enter(NoOp, VtParser::DcsIgnore));
+    setRange(table, VtParser::DcsParam, 0x3c, 0x3f, enter(NoOp, VtParser::DcsIgnore));
+    setRange(table, VtParser::DcsParam, 0x40, 0x7e, enter(NoOp, VtParser::DcsPassthrough));
+
+    setRange(table, VtParser::DcsIntermediate, 0x20, 0x2f, stay(CollectChar, VtParser::DcsIntermediate));
+    setRange(table, VtParser::DcsIntermediate, 0x30, 0x3f, enter(NoOp, VtParser::DcsIgnore));
+    setRange(table, VtParser::DcsIntermediate, 0x40, 0x7e, enter(NoOp, VtParser::DcsPassthrough));
+
+    setRange(table, VtParser::DcsPassthrough, 0x20, 0x7e, stay(PutDcs, VtParser::DcsPassthrough));
+    setRange(table, VtParser::DcsPassthrough, 0xa0, 0xa0, stay(PutDcs, VtParser::DcsPassthrough));
+
+    setRange(table, VtParser::OscString, 0x07, 0x07, enter(EndOsc, VtParser::Ground));
+    setRange(table, VtParser::OscString, 0x20, 0x7f, stay(PutOsc, VtParser::OscString));
+    setRange(table, VtParser::OscString, 0xa0, 0xa0, stay(PutOsc, VtParser::OscString));
+
+    // transitions which apply in every state
+    for (int s = 0; s < VtParser::StateCount; s++) {
+        const VtParser::State state = VtParser::State(s);
+        const bool inOsc = (state == VtParser::OscString);
+
+        setRange(table, state, 0x18, 0x18, enter(ExecuteChar, VtParser::Ground));
+        setRange(table, state, 0x1a, 0x1a, enter(ExecuteChar, VtParser::Ground));
+        setRange(table, state, 0x1b, 0x1b, enter(inOsc ? EndOsc : NoOp, VtParser::Escape));
+
+        // C1 controls
+        setRange(table, state, 0x80, 0x9f, enter(NoOp, VtParser::Ground));
+        setRange(table, state, 0x90, 0x90, enter(NoOp, VtParser::DcsEntry));
+        setRange(table, state, 0x98, 0x98, enter(NoOp, VtParser::SosPmApcString));
+        setRange(table, state, 0x9b, 0x9b, enter(NoOp, VtParser::CsiEntry));
+        setRange(table, state, 0x9c, 0x9c, enter(inOsc ? EndOsc : NoOp, VtParser::Ground));
+        setRange(table, state, 0x9d, 0x9d, enter(NoOp, VtParser::OscString));
+        setRange(table, state, 0x9e, 0x9f, enter(NoOp, VtParser::SosPmApcString));
+    }
+
+    return table;
+}
+
+constexpr TransitionTable transitions = buildTransitionTable();
+
+}
+
+VtParser::VtParser()
+{
+    _osc.reserve(256);
+    reset();
+}
+
+void VtParser::reset()
+{
+    _state = Ground;
+    _character = 0;
+    _osc.clear();
+    clear();
+}
+
+void VtParser::clear()
+{
+    _privateMarker = 0;
+    _intermediateCount = 0;
+    _ignoreSequence = false;
+    // parameters() exposes the first entry even if no parameter was given
+    _parameters[0] = 0;
+    _parameterCount = 0;
+}
+
+void VtParser::collect(wchar_t c)
+{
+    if (c >= 0x3c && c <= 0x3f) {
+        // only collected directly after the introducer
+        _privateMarker = static_cast<char>(c);
+    } else if (_intermediateCount < MaxIntermediates) {
+        _intermediates[_intermediateCount++] = static_cast<char>(c);
+    } else {
+        // the sequence can not be recorded as sent, so it is not
+        // dispatched at all rather than as a different one
+        _ignoreSequence = true;
+    }
+}
+
+void VtParser::param(wchar_t c)
+{
+    if (_parameterCount == 0)
+        _parameterCount = 1;
+
+    if (c == ';' || c == ':') {
+        if (_parameterCount < MaxParameters) {
+            _parameters[_parameterCount++] = 0;
+        } else {
+            // like the old tokenizer, excess parameters overwrite the last one
+            _parameters[MaxParameters - 1] = 0;
+        }
+        return;
+    }
+
+    int& value = _parameters[_parameterCount - 1];
+    value = value * 10 + (c - '0');
+    if (value > MaxParameterValue)
+        value = MaxParameterValue;
+}
+
+VtParser::Result VtParser::advance(wchar_t c)
+{
+    _character = c;
+
+    const unsigned int code = static_cast<unsigned int>(c);
+    const unsigned short entry = transitions.entries[_state][code < TABLE_COLUMNS ? code : TABLE_COLUMNS - 1];
+
+    if (entry & ENTER) {
+        _state = entry & 0xf;
+        switch (_state) {
+        case Escape:
+        case CsiEntry:
+        case DcsEntry:
+            clear();
+            break;
+        case OscString:
+            _osc.clear();
+            break;
+        default:
+            break;
+        }
+    }
+
+    switch ((entry >> 4) & 0xf) {
+    case PrintChar:
+        return VtParser::Print;
+    case ExecuteChar:
+        return VtParser::Execute;
+    case CollectChar:
+        collect(c);
+        return NoAction;
+    case AddParam:
+        param(c);
+        return NoAction;
+    case DispatchEsc:
+        return _ignoreSequence ? NoAction : VtParser::EscDispatch;
+    case DispatchCsi:
+        return _ignoreSequence ? NoAction : VtParser::CsiDispatch;
+    case PutOsc:
+        if (_osc.size() < MaxOscLength)
+            _osc.push_back(c);
+        return NoAction;
+    case EndOsc:
+        return VtParser::OscDispatch;
+    default:
+        return NoAction;
+    }
+}
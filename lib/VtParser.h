@@ -0,0 +1,154 @@
+/*
+    This file is part of Konsole, an X terminal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef VTPARSER_H
+#define VTPARSER_H
+
+// Standard Library
+#include <vector>
+
+namespace Konsole
+{
+
+/**
+ * A table driven parser for DEC/ANSI escape sequences, following the
+ * state machine described at https://vt100.net/emu/dec_ansi_parser
+ *
+ * Each character is handled by a single lookup in a transition table which
+ * yields the action to perform and the next state. Parameters and
+ * intermediate characters are accumulated as they arrive, so a sequence is
+ * never re-scanned and the cost of parsing is linear in its length.
+ *
+ * The parser does not interpret sequences itself. advance() returns what
+ * the caller has to do with the character just fed (print it, execute it as
+ * a control function or dispatch a completed sequence), and the accessors
+ * describe the sequence which was completed.
+ *
+ * Differences from the DEC description:
+ *  - ':' is accepted as a parameter separator and treated like ';', so
+ *    sub-parameters as in "CSI 38:2:r:g:b m" show up as plain parameters
+ *  - OSC strings may also be terminated by BEL, as in xterm
+ *  - DCS, SOS, PM and APC strings are consumed and ignored
+ */
+class VtParser
+{
+public:
+    enum State
+    {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        CsiEntry,
+        CsiParam,
+        CsiIntermediate,
+        CsiIgnore,
+        OscString,
+        DcsEntry,
+        DcsParam,
+        DcsIntermediate,
+        DcsPassthrough,
+        DcsIgnore,
+        SosPmApcString,
+        StateCount
+    };
+
+    /** What the caller has to do with the character passed to advance() */
+    enum Result
+    {
+        NoAction,       ///< the character was consumed by the parser
+        Print,          ///< display character()
+        Execute,        ///< execute the C0 control character()
+        EscDispatch,    ///< an escape sequence ending in character() is complete
+        CsiDispatch,    ///< a control sequence ending in character() is complete
+        OscDispatch     ///< an operating system command is complete, see oscData()
+    };
+
+    enum
+    {
+        MaxParameters = 32,
+        MaxIntermediates = 2,
+        MaxParameterValue = 65535,
+        MaxOscLength = 65536
+    };
+
+    VtParser();
+
+    /** Returns to the ground state, discarding any partial sequence. */
+    void reset();
+
+    /** Feeds the next character of the stream to the parser. */
+    Result advance(wchar_t c);
+
+    State state() const { return static_cast<State>(_state); }
+    bool isGround() const { return _state == Ground; }
+
+    /** The character passed to the last advance() call. */
+    wchar_t character() const { return _character; }
+
+    /**
+     * The private marker ('<', '=', '>' or '?') given right after the
+     * control sequence introducer, or 0.
+     */
+    char privateMarker() const { return _privateMarker; }
+
+    int intermediateCount() const { return _intermediateCount; }
+    char intermediate(int index) const { return _intermediates[index]; }
+
+    /**
+     * The number of parameters of the sequence. A sequence without any
+     * parameters is reported as having a single, empty (0) parameter.
+     */
+    int parameterCount() const { return _parameterCount > 0 ? _parameterCount : 1; }
+
+    /** Parameter @p index, 0 if it was omitted. */
+    int parameter(int index) const { return index < _parameterCount ? _parameters[index] : 0; }
+
+    /**
+     * All parameters, parameterCount() entries. The first entry is 0 for a
+     * sequence without parameters.
+     */
+    const int* parameters() const { return _parameters; }
+
+    /**
+     * The payload of the last operating system command, excluding the
+     * introducer and the terminator. Payloads longer than MaxOscLength are
+     * truncated.
+     */
+    const wchar_t* oscData() const { return _osc.data(); }
+    int oscLength() const { return static_cast<int>(_osc.size()); }
+
+private:
+    void clear();
+    void collect(wchar_t c);
+    void param(wchar_t c);
+
+    unsigned char _state;
+    wchar_t _character;
+    char _privateMarker;
+    char _intermediates[MaxIntermediates];
+    int _intermediateCount;
+    bool _ignoreSequence; // more than MaxIntermediates intermediates were seen
+    int _parameters[MaxParameters];
+    int _parameterCount;
+    std::vector<wchar_t> _osc;
+};
+
+}
+
+#endif // VTPARSER_H
@@ -13,8 +13,10 @@
 // Standard
 #include <string>
 
-int konsole_wcwidth(wchar_t ucs);
+#include "qtermwidget_core_export.h"
 
-int string_width( const std::wstring & wstr );
+QTERMWIDGET_CORE_EXPORT int konsole_wcwidth(wchar_t ucs);
+
+QTERMWIDGET_CORE_EXPORT int string_width( const std::wstring & wstr );
 
 #endif
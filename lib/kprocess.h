@@ -36,6 +36,8 @@
 
 #include <memory>
 
+#include "qtermwidget_core_export.h"
+
 class KProcessPrivate;
 
 /**
@@ -51,7 +53,7 @@ class KProcessPrivate;
  *
  * @author Oswald Buddenhagen <ossi@kde.org>
  **/
-class KProcess : public QProcess
+class QTERMWIDGET_CORE_EXPORT KProcess : public QProcess
 {
     Q_OBJECT
     Q_DECLARE_PRIVATE(KProcess)
@@ -27,6 +27,8 @@
 
 #include <memory>
 
+#include "qtermwidget_core_export.h"
+
 class KPtyPrivate;
 struct termios;
 
@@ -34,7 +36,7 @@ struct termios;
  * Provides primitives for opening & closing a pseudo TTY pair, assigning the
  * controlling TTY, utmp registration and setting various terminal attributes.
  */
-class KPty {
+class QTERMWIDGET_CORE_EXPORT KPty {
     Q_DECLARE_PRIVATE(KPty)
 
 public:
@@ -33,8 +33,13 @@
 #include "kpty_p.h"
 
 #include <QSocketNotifier>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDeadlineTimer>
 
 #include <unistd.h>
+#include <poll.h>
 #include <cerrno>
 #include <csignal>
 #include <termios.h>
@@ -80,6 +85,205 @@ static void qt_ignore_sigpipe()
 
 #define NO_INTR(ret,func) do { ret = func; } while (ret < 0 && errno == EINTR)
 
+/////////////////////////
+// threaded pty reader //
+/////////////////////////
+
+/*
+ * Drains the pty master on its own thread into a KSpscRingBuffer.
+ *
+ * The device's thread is woken up with a queued _k_readFromThread() call
+ * once per batch: a new call is only posted after the previous one started
+ * draining. When the ring is full the reader stops polling the pty (so the
+ * kernel applies back-pressure to the child) until the consumer frees space.
+ * A self-pipe is used to interrupt poll() for suspend/resume and shutdown.
+ */
+class KPtyReaderThread : public QThread
+{
+public:
+    KPtyReaderThread(KPtyDevice *device) :
+        device(device), fd(device->masterFd()),
+        wakeupPending(false), blocked(false), suspended(false),
+        stopping(false), eof(false), consumerWaiting(false)
+    {
+        if (::pipe(wakePipe) == 0) {
+            for (int pfd : wakePipe) {
+                fcntl(pfd, F_SETFL, O_NONBLOCK);
+                fcntl(pfd, F_SETFD, FD_CLOEXEC);
+            }
+        } else {
+            wakePipe[0] = wakePipe[1] = -1;
+        }
+    }
+
+    ~KPtyReaderThread() override
+    {
+        stop();
+        if (wakePipe[0] >= 0) {
+            ::close(wakePipe[0]);
+            ::close(wakePipe[1]);
+        }
+    }
+
+    void stop()
+    {
+        stopping.store(true);
+        wake();
+        wait();
+    }
+
+    void setSuspended(bool suspend)
+    {
+        suspended.store(suspend);
+        wake();
+    }
+
+    bool isSuspended() const
+    {
+        return suspended.load();
+    }
+
+    // true once the reader has seen EOF or an error on the pty
+    bool atEnd() const
+    {
+        return eof.load();
+    }
+
+    // Moves everything currently in the ring into @p target.
+    // Must only be called from the consumer (device) thread.
+    int drain(KRingBuffer &target)
+    {
+        wakeupPending.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int total = 0;
+        while (int bytes = ring.readSize()) {
+            memcpy(target.reserve(bytes), ring.readPointer(), bytes);
+            ring.free(bytes);
+            total += bytes;
+        }
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blocked.exchange(false))
+            wake();
+        return total;
+    }
+
+    // Blocks the consumer thread until data or EOF arrives.
+    bool waitForData(int msecs)
+    {
+        QDeadlineTimer deadline(msecs < 0 ? QDeadlineTimer::Forever : QDeadlineTimer(msecs));
+        QMutexLocker locker(&waitMutex);
+        consumerWaiting.store(true);
+        // pairs with the fence in notify(): either the reader sees
+        // consumerWaiting or this thread sees the data it committed
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (ring.isEmpty() && !eof.load()) {
+            if (!dataAvailable.wait(&waitMutex, deadline))
+                break;
+        }
+        consumerWaiting.store(false);
+        return !ring.isEmpty() || eof.load();
+    }
+
+protected:
+    void run() override
+    {
+        forever {
+            if (stopping.load())
+                return;
+
+            int space = ring.writeSize();
+            if (!space) {
+                blocked.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                space = ring.writeSize();
+                if (space)
+                    blocked.store(false);
+            }
+
+            struct pollfd fds[2];
+            // a negative fd is ignored by poll(), events = 0 would still report POLLHUP
+            fds[0].fd = (space && !suspended.load()) ? fd : -1;
+            fds[0].events = POLLIN;
+            fds[0].revents = 0;
+            fds[1].fd = wakePipe[0];
+            fds[1].events = POLLIN;
+            fds[1].revents = 0;
+
+            int ret;
+            NO_INTR(ret, ::poll(fds, 2, -1));
+            if (ret < 0) {
+                finish();
+                return;
+            }
+
+            if (fds[1].revents & POLLIN) {
+                char buf[64];
+                while (::read(wakePipe[0], buf, sizeof(buf)) > 0)
+                    ;
+            }
+
+            if (fds[0].fd < 0 || !(fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            ssize_t readBytes;
+            NO_INTR(readBytes, ::read(fd, ring.writePointer(), space));
+            if (readBytes > 0) {
+                ring.commit(readBytes);
+                notify();
+            } else if (readBytes == 0 || errno != EAGAIN) {
+                finish();
+                return;
+            }
+        }
+    }
+
+private:
+    void wake()
+    {
+        if (wakePipe[1] >= 0) {
+            char c = 0;
+            int ret;
+            NO_INTR(ret, ::write(wakePipe[1], &c, 1));
+            Q_UNUSED(ret);
+        }
+    }
+
+    void notify()
+    {
+        // order the commit of the data before reading consumerWaiting,
+        // see waitForData()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumerWaiting.load()) {
+            QMutexLocker locker(&waitMutex);
+            dataAvailable.wakeAll();
+        }
+        if (!wakeupPending.exchange(true))
+            QMetaObject::invokeMethod(device, "_k_readFromThread", Qt::QueuedConnection);
+    }
+
+    void finish()
+    {
+        eof.store(true);
+        wakeupPending.store(false);
+        notify();
+    }
+
+    KPtyDevice *device;
+    int fd;
+    int wakePipe[2];
+    KSpscRingBuffer ring;
+    std::atomic<bool> wakeupPending;
+    std::atomic<bool> blocked;
+    std::atomic<bool> suspended;
+    std::atomic<bool> stopping;
+    std::atomic<bool> eof;
+    std::atomic<bool> consumerWaiting;
+    QMutex waitMutex;
+    QWaitCondition dataAvailable;
+};
+
 bool KPtyDevicePrivate::_k_canRead()
 {
     Q_Q(KPtyDevice);
@@ -150,6 +354,57 @@ bool KPtyDevicePrivate::_k_canRead()
     }
 }
 
+bool KPtyDevicePrivate::_k_readFromThread()
+{
+    Q_Q(KPtyDevice);
+
+    if (!readerThread)
+        return false;
+
+    bool gotData = readerThread->drain(readBuffer) > 0;
+    if (gotData && !emittedReadyRead) {
+        emittedReadyRead = true;
+        emit q->readyRead();
+        emittedReadyRead = false;
+    }
+
+    // readyRead() handlers may have switched threading off
+    if (readerThread && readerThread->atEnd()) {
+        // pick up anything committed between the drain and the EOF
+        stopReaderThread();
+        if (!readBuffer.isEmpty() && !emittedReadyRead) {
+            emittedReadyRead = true;
+            emit q->readyRead();
+            emittedReadyRead = false;
+        }
+        emit q->readEof();
+    }
+    return gotData;
+}
+
+void KPtyDevicePrivate::startReaderThread()
+{
+    Q_Q(KPtyDevice);
+
+    bool suspended = !readNotifier->isEnabled();
+    readNotifier->setEnabled(false);
+    readerThread = new KPtyReaderThread(q);
+    readerThread->setSuspended(suspended);
+    readerThread->start();
+}
+
+int KPtyDevicePrivate::stopReaderThread()
+{
+    if (!readerThread)
+        return 0;
+
+    readerThread->stop();
+    int bytes = readerThread->drain(readBuffer);
+    delete readerThread;
+    readerThread = nullptr;
+    return bytes;
+}
+
 bool KPtyDevicePrivate::_k_canWrite()
 {
     Q_Q(KPtyDevice);
@@ -210,6 +465,14 @@ bool KPtyDevicePrivate::doWait(int msecs, bool reading)
 #endif
     struct timeval tv, *tvp;
 
+    if (reading && readerThread) {
+        if (!readerThread->waitForData(msecs)) {
+            q->setErrorString(QLatin1String("PTY operation timed out"));
+            return false;
+        }
+        return _k_readFromThread() || !readBuffer.isEmpty();
+    }
+
     if (msecs < 0)
         tvp = nullptr;
     else {
@@ -280,6 +543,8 @@ void KPtyDevicePrivate::finishOpen(QIODevice::OpenMode mode)
     QObject::connect(readNotifier, SIGNAL(activated(int)), q, SLOT(_k_canRead()));
     QObject::connect(writeNotifier, SIGNAL(activated(int)), q, SLOT(_k_canWrite()));
     readNotifier->setEnabled(true);
+    if (threadedReading)
+        startReaderThread();
 }
 
 /////////////////////////////
@@ -335,6 +600,7 @@ void KPtyDevice::close()
     if (masterFd() < 0)
         return;
 
+    d->stopReaderThread();
     delete d->readNotifier;
     delete d->writeNotifier;
 
@@ -387,15 +653,68 @@ bool KPtyDevice::waitForBytesWritten(int msecs)
 void KPtyDevice::setSuspended(bool suspended)
 {
     Q_D(KPtyDevice);
+    if (d->threadedReading) {
+        if (d->readerThread)
+            d->readerThread->setSuspended(suspended);
+        return;
+    }
     d->readNotifier->setEnabled(!suspended);
 }
 
 bool KPtyDevice::isSuspended() const
 {
     Q_D(const KPtyDevice);
+    if (d->threadedReading)
+        return !d->readerThread || d->readerThread->isSuspended();
     return !d->readNotifier->isEnabled();
 }
 
+void KPtyDevice::setThreadedReading(bool threaded)
+{
+    Q_D(KPtyDevice);
+
+    if (d->threadedReading == threaded)
+        return;
+    d->threadedReading = threaded;
+
+    // otherwise finishOpen() takes care of it
+    if (masterFd() < 0)
+        return;
+
+    if (threaded) {
+        d->startReaderThread();
+    } else if (d->readerThread) {
+        bool suspended = d->readerThread->isSuspended();
+        bool hadData = d->stopReaderThread() > 0;
+        d->readNotifier->setEnabled(!suspended);
+        if (hadData && !d->emittedReadyRead) {
+            d->emittedReadyRead = true;
+            emit readyRead();
+            d->emittedReadyRead = false;
+        }
+    }
+}
+
+bool KPtyDevice::isThreadedReading() const
+{
+    Q_D(const KPtyDevice);
+    return d->threadedReading;
+}
+
+QByteArrayView KPtyDevice::peekChunk() const
+{
+    Q_D(const KPtyDevice);
+    if (d->readBuffer.isEmpty())
+        return QByteArrayView();
+    return QByteArrayView(d->readBuffer.readPointer(), d->readBuffer.readSize());
+}
+
+void KPtyDevice::releaseChunk(qint64 bytes)
+{
+    Q_D(KPtyDevice);
+    d->readBuffer.free(static_cast<int>(qMin<qint64>(bytes, d->readBuffer.size())));
+}
+
 // protected
 qint64 KPtyDevice::readData(char *data, qint64 maxlen)
 {
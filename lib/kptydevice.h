@@ -32,16 +32,18 @@
 #include "kpty_p.h"
 
 #include <QIODevice>
+#include <QByteArrayView>
 
 #define KMAXINT ((int)(~0U >> 1))
 
 class KPtyDevicePrivate;
+class KPtyReaderThread;
 class QSocketNotifier;
 
 /**
  * Encapsulates KPty into a QIODevice, so it can be used with Q*Stream, etc.
  */
-class KPtyDevice : public QIODevice, public KPty {
+class QTERMWIDGET_CORE_EXPORT KPtyDevice : public QIODevice, public KPty {
     Q_OBJECT
     Q_DECLARE_PRIVATE_D(KPty::d_ptr, KPtyDevice)
 
@@ -111,6 +113,46 @@ public:
      */
     bool isSuspended() const;
 
+    /**
+     * Sets whether incoming data is read from the pty on a dedicated
+     * I/O thread instead of through a socket notifier in the thread
+     * this device lives in.
+     *
+     * In threaded mode the reader thread drains the pty master into a
+     * lock-free single-producer/single-consumer ring and wakes up the
+     * owning thread once per batch, which then moves the data into the
+     * read buffer and emits readyRead(). A busy owning thread (e.g. the
+     * GUI thread while repainting) therefore no longer stalls the child
+     * process on a full tty buffer.
+     *
+     * May be called before or after open().
+     */
+    void setThreadedReading(bool threaded);
+
+    /**
+     * Returns true if incoming data is read on a dedicated I/O thread.
+     *
+     * See setThreadedReading()
+     */
+    bool isThreadedReading() const;
+
+    /**
+     * Returns the next contiguous block of buffered incoming data without
+     * copying it. The view stays valid until the data is consumed with
+     * releaseChunk() or any of the read functions, so it can be processed
+     * in place. An empty view is returned if no data is buffered.
+     *
+     * Only valid for unbuffered devices (the default open mode), as data in
+     * QIODevice's own buffer is not visible here.
+     */
+    QByteArrayView peekChunk() const;
+
+    /**
+     * Discards @p bytes from the front of the buffered incoming data,
+     * typically the size of the view returned by peekChunk().
+     */
+    void releaseChunk(qint64 bytes);
+
     /**
      * @return always true
      */
@@ -156,6 +198,7 @@ protected:
 private:
     Q_PRIVATE_SLOT(d_func(), bool _k_canRead())
     Q_PRIVATE_SLOT(d_func(), bool _k_canWrite())
+    Q_PRIVATE_SLOT(d_func(), bool _k_readFromThread())
 };
 
 /////////////////////////////////////////////////////
@@ -163,7 +206,9 @@ private:
 /////////////////////////////////////////////////////
 
 #include <QByteArray>
+#include <atomic>
 #include <list>
+#include <vector>
 
 #define CHUNKSIZE 4096
 
@@ -327,6 +372,76 @@ private:
     int totalSize;
 };
 
+/**
+ * Fixed size byte ring for handing data from exactly one producer thread
+ * to exactly one consumer thread without locking.
+ *
+ * The producer fills writePointer()/writeSize() and publishes the bytes
+ * with commit(), the consumer reads readPointer()/readSize() and hands
+ * the space back with free(). Both sides only ever see contiguous spans,
+ * so a wrap-around takes two rounds.
+ */
+#define SPSC_RINGSIZE (1 << 20)
+
+class KSpscRingBuffer
+{
+public:
+    KSpscRingBuffer() :
+        buffer(SPSC_RINGSIZE), writePos(0), readPos(0)
+    {
+    }
+
+    // producer side
+
+    inline int writeSize() const
+    {
+        size_t w = writePos.load(std::memory_order_relaxed);
+        size_t r = readPos.load(std::memory_order_acquire);
+        return static_cast<int>(qMin<size_t>(SPSC_RINGSIZE - (w - r),
+                                             SPSC_RINGSIZE - (w & (SPSC_RINGSIZE - 1))));
+    }
+
+    inline char *writePointer()
+    {
+        return buffer.data() + (writePos.load(std::memory_order_relaxed) & (SPSC_RINGSIZE - 1));
+    }
+
+    inline void commit(int bytes)
+    {
+        writePos.store(writePos.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+    // consumer side
+
+    inline bool isEmpty() const
+    {
+        return readPos.load(std::memory_order_relaxed) == writePos.load(std::memory_order_acquire);
+    }
+
+    inline int readSize() const
+    {
+        size_t r = readPos.load(std::memory_order_relaxed);
+        size_t w = writePos.load(std::memory_order_acquire);
+        return static_cast<int>(qMin<size_t>(w - r, SPSC_RINGSIZE - (r & (SPSC_RINGSIZE - 1))));
+    }
+
+    inline const char *readPointer() const
+    {
+        return buffer.data() + (readPos.load(std::memory_order_relaxed) & (SPSC_RINGSIZE - 1));
+    }
+
+    inline void free(int bytes)
+    {
+        readPos.store(readPos.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+    }
+
+private:
+    std::vector<char> buffer;
+    // keep the two indices on separate cache lines
+    alignas(64) std::atomic<size_t> writePos;
+    alignas(64) std::atomic<size_t> readPos;
+};
+
 class KPtyDevicePrivate : public KPtyPrivate {
 
     Q_DECLARE_PUBLIC(KPtyDevice)
@@ -335,20 +450,27 @@ public:
     KPtyDevicePrivate(KPty* parent) :
         KPtyPrivate(parent),
         emittedReadyRead(false), emittedBytesWritten(false),
-        readNotifier(nullptr), writeNotifier(nullptr)
+        threadedReading(false),
+        readNotifier(nullptr), writeNotifier(nullptr),
+        readerThread(nullptr)
     {
     }
 
     bool _k_canRead();
     bool _k_canWrite();
+    bool _k_readFromThread();
 
     bool doWait(int msecs, bool reading);
     void finishOpen(QIODevice::OpenMode mode);
+    void startReaderThread();
+    int stopReaderThread();
 
     bool emittedReadyRead;
     bool emittedBytesWritten;
+    bool threadedReading;
     QSocketNotifier *readNotifier;
     QSocketNotifier *writeNotifier;
+    KPtyReaderThread *readerThread;
     KRingBuffer readBuffer;
     KRingBuffer writeBuffer;
 };
@@ -55,7 +55,7 @@ class KPtyProcessPrivate;
  *
  * @author Oswald Buddenhagen <ossi@kde.org>
  */
-class KPtyProcess : public KProcess
+class QTERMWIDGET_CORE_EXPORT KPtyProcess : public KProcess
 {
     Q_OBJECT
     Q_DECLARE_PRIVATE(KPtyProcess)
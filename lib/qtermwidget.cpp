@@ -21,7 +21,9 @@
 #include <QtDebug>
 #include <QDir>
 #include <QMessageBox>
+#include <QMetaMethod>
 #include <QRegularExpression>
+#include <QThread>
 
 #include "ColorTables.h"
 #include "Session.h"
@@ -57,6 +59,7 @@ public:
 
     TerminalDisplay *m_terminalDisplay;
     Session *m_session;
+    bool m_historyCompressed = false;
 
     Session* createSession(QWidget* parent);
     TerminalDisplay* createTerminalDisplay(Session *session, QWidget* parent);
@@ -123,12 +126,14 @@ TerminalDisplay *TermWidgetImpl::createTerminalDisplay(Session *session, QWidget
 
 QTermWidget::QTermWidget(int startnow, QWidget *parent)
     : QWidget(parent)
+    , m_impl(nullptr)
 {
     init(startnow);
 }
 
 QTermWidget::QTermWidget(QWidget *parent)
     : QWidget(parent)
+    , m_impl(nullptr)
 {
     init(1);
 }
@@ -157,6 +162,7 @@ void QTermWidget::search(bool forwards, bool next)
 {
     int startColumn, startLine;
 
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     if (next) // search from just after current selection
     {
         m_impl->m_terminalDisplay->screenWindow()->screen()->getSelectionEnd(startColumn, startLine);
@@ -166,6 +172,7 @@ void QTermWidget::search(bool forwards, bool next)
     {
         m_impl->m_terminalDisplay->screenWindow()->screen()->getSelectionStart(startColumn, startLine);
     }
+    locker.unlock();
 
     //qDebug() << "current selection starts at: " << startColumn << startLine;
     //qDebug() << "current cursor position: " << m_impl->m_terminalDisplay->screenWindow()->cursorPosition();
@@ -269,9 +276,20 @@ void QTermWidget::startTerminalTeletype()
     }
 
     m_impl->m_session->runEmptyPTY();
-    // redirect data from TTY to external recipient
-    connect( m_impl->m_session->emulation(), SIGNAL(sendData(const char *,int)),
-             this, SIGNAL(sendData(const char *,int)) );
+    // redirect data from TTY to external recipient. The buffer is only valid
+    // during the emission, so it is copied before it leaves the emulation's thread
+    connect( m_impl->m_session->emulation(), &Emulation::sendData, this,
+             [this](const char* data, int length) {
+                 if (QThread::currentThread() == thread()) {
+                     emit sendData(data, length);
+                     return;
+                 }
+
+                 const QByteArray copy(data, length);
+                 QMetaObject::invokeMethod(this, [this, copy] {
+                     emit sendData(copy.constData(), copy.size());
+                 }, Qt::QueuedConnection);
+             }, Qt::DirectConnection );
 }
 
 void QTermWidget::init(int startnow)
@@ -315,7 +333,7 @@ void QTermWidget::init(int startnow)
     connect(m_impl->m_session, SIGNAL(activity()), this, SIGNAL(activity()));
     connect(m_impl->m_session, SIGNAL(silence()), this, SIGNAL(silence()));
     connect(m_impl->m_session, &Session::profileChangeCommandReceived, this, &QTermWidget::profileChanged);
-    connect(m_impl->m_session, &Session::receivedData, this, &QTermWidget::receivedData);
+    // receivedData() is only forwarded while connected, see connectNotify()
 
     // That's OK, FilterChain's dtor takes care of UrlFilter.
     UrlFilter *urlFilter = new UrlFilter();
@@ -371,6 +389,7 @@ void QTermWidget::init(int startnow)
 QTermWidget::~QTermWidget()
 {
     delete m_impl;
+    m_impl = nullptr;
     emit destroyed();
 }
 
@@ -514,7 +533,9 @@ void QTermWidget::setSize(const QSize &size)
 
 void QTermWidget::setHistorySize(int lines)
 {
-    if (lines < 0)
+    if (m_impl->m_historyCompressed && lines != 0)
+        m_impl->m_session->setHistoryType(CompressedHistoryType(lines > 0 ? lines : 0));
+    else if (lines < 0)
         m_impl->m_session->setHistoryType(HistoryTypeFile());
     else if (lines == 0)
         m_impl->m_session->setHistoryType(HistoryTypeNone());
@@ -524,17 +545,23 @@ void QTermWidget::setHistorySize(int lines)
 
 int QTermWidget::historySize() const
 {
-    const HistoryType& currentHistory = m_impl->m_session->historyType();
+    return m_impl->m_session->historySize();
+}
+
+void QTermWidget::setHistoryCompressed(bool compressed)
+{
+    if (m_impl->m_historyCompressed == compressed)
+        return;
 
-     if (currentHistory.isEnabled()) {
-         if (currentHistory.isUnlimited()) {
-             return -1;
-         } else {
-             return currentHistory.maximumLineCount();
-         }
-     } else {
-         return 0;
-     }
+    m_impl->m_historyCompressed = compressed;
+    const int lines = historySize();
+    if (lines != 0)
+        setHistorySize(lines);
+}
+
+bool QTermWidget::historyCompressed() const
+{
+    return m_impl->m_historyCompressed;
 }
 
 void QTermWidget::setScrollBarPosition(ScrollBarPosition pos)
@@ -624,7 +651,11 @@ void QTermWidget::setKeyBindings(const QString & kb)
 
 void QTermWidget::clear()
 {
-    m_impl->m_session->emulation()->reset();
+    Emulation* emulation = m_impl->m_session->emulation();
+    QMetaObject::invokeMethod(emulation, [emulation] {
+        QMutexLocker locker(emulation->screenLock());
+        emulation->reset();
+    });
     m_impl->m_session->refresh();
     m_impl->m_session->clearHistory();
 }
@@ -654,6 +685,73 @@ bool QTermWidget::flowControlEnabled(void)
     return m_impl->m_session->flowControlEnabled();
 }
 
+void QTermWidget::setThreadedPtyReading(bool threaded)
+{
+    m_impl->m_session->setThreadedPtyReading(threaded);
+}
+
+bool QTermWidget::threadedPtyReading() const
+{
+    return m_impl->m_session->threadedPtyReading();
+}
+
+void QTermWidget::setThreadedEmulation(bool threaded)
+{
+    m_impl->m_session->setThreadedEmulation(threaded);
+}
+
+bool QTermWidget::threadedEmulation() const
+{
+    return m_impl->m_session->threadedEmulation();
+}
+
+bool QTermWidget::startRecording(const QString& fileName)
+{
+    return m_impl->m_session->startRecording(fileName);
+}
+
+void QTermWidget::stopRecording()
+{
+    m_impl->m_session->stopRecording();
+}
+
+bool QTermWidget::isRecording() const
+{
+    return m_impl->m_session->isRecording();
+}
+
+void QTermWidget::setUpdatePolicy(UpdatePolicy policy)
+{
+    m_impl->m_session->emulation()->setUpdatePolicy(policy);
+}
+
+QTermWidget::UpdatePolicy QTermWidget::updatePolicy() const
+{
+    return m_impl->m_session->emulation()->updatePolicy();
+}
+
+void QTermWidget::setRawOutputTap(const std::function<void(QByteArrayView data)>& tap)
+{
+    m_impl->m_session->setRawOutputTap(tap);
+}
+
+void QTermWidget::connectNotify(const QMetaMethod &signal)
+{
+    // The session converts every block of output to a QString for
+    // receivedData(), so only forward it while someone is listening.
+    if (m_impl && signal == QMetaMethod::fromSignal(&QTermWidget::receivedData))
+        connect(m_impl->m_session, &Session::receivedData, this, &QTermWidget::receivedData, Qt::UniqueConnection);
+    QWidget::connectNotify(signal);
+}
+
+void QTermWidget::disconnectNotify(const QMetaMethod &signal)
+{
+    if (m_impl && signal == QMetaMethod::fromSignal(&QTermWidget::receivedData)
+        && !isSignalConnected(signal))
+        disconnect(m_impl->m_session, &Session::receivedData, this, &QTermWidget::receivedData);
+    QWidget::disconnectNotify(signal);
+}
+
 void QTermWidget::setFlowControlWarningEnabled(bool enabled)
 {
     if (flowControlEnabled()) {
@@ -674,41 +772,49 @@ void QTermWidget::setMotionAfterPasting(int action)
 
 int QTermWidget::historyLinesCount()
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     return m_impl->m_terminalDisplay->screenWindow()->screen()->getHistLines();
 }
 
 int QTermWidget::screenColumnsCount()
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     return m_impl->m_terminalDisplay->screenWindow()->screen()->getColumns();
 }
 
 int QTermWidget::screenLinesCount()
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     return m_impl->m_terminalDisplay->screenWindow()->screen()->getLines();
 }
 
 void QTermWidget::setSelectionStart(int row, int column)
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     m_impl->m_terminalDisplay->screenWindow()->screen()->setSelectionStart(column, row, true);
 }
 
 void QTermWidget::setSelectionEnd(int row, int column)
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     m_impl->m_terminalDisplay->screenWindow()->screen()->setSelectionEnd(column, row);
 }
 
 void QTermWidget::getSelectionStart(int& row, int& column)
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     m_impl->m_terminalDisplay->screenWindow()->screen()->getSelectionStart(column, row);
 }
 
 void QTermWidget::getSelectionEnd(int& row, int& column)
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     m_impl->m_terminalDisplay->screenWindow()->screen()->getSelectionEnd(column, row);
 }
 
 QString QTermWidget::selectedText(bool preserveLineBreaks)
 {
+    QMutexLocker locker(m_impl->m_session->emulation()->screenLock());
     return m_impl->m_terminalDisplay->screenWindow()->screen()->selectedText(preserveLineBreaks);
 }
 
@@ -822,7 +928,7 @@ void QTermWidget::saveHistory(QIODevice *device)
 
 void QTermWidget::receiveData(const char *buffer, int len)
 {
-    m_impl->m_session->emulation()->receiveData(buffer, len);
+    m_impl->m_session->receiveData(buffer, len);
 }
 
 void QTermWidget::setDrawLineChars(bool drawLineChars)
@@ -20,6 +20,9 @@
 #ifndef _Q_TERM_WIDGET
 #define _Q_TERM_WIDGET
 
+#include <functional>
+
+#include <QByteArrayView>
 #include <QTranslator>
 #include <QWidget>
 #include "Emulation.h"
@@ -41,6 +44,7 @@ class QTERMWIDGET_EXPORT QTermWidget : public QWidget, public QTermWidgetInterfa
 public:
 
     using KeyboardCursorShape = Konsole::Emulation::KeyboardCursorShape;
+    using UpdatePolicy = Konsole::Emulation::UpdatePolicy;
 
     //Creation of widget
     QTermWidget(int startnow, // 1 = start shell program immediately
@@ -130,6 +134,15 @@ public:
     // Returns the history size (in lines)
     int historySize() const override;
 
+    /**
+     * Sets whether the history compresses older lines in memory instead of
+     * keeping them as they are (or in a file, for an infinite history).
+     * Takes effect immediately and for later calls to setHistorySize().
+     * Disabled by default.
+     */
+    void setHistoryCompressed(bool compressed);
+    bool historyCompressed() const;
+
     // Presence of scrollbar
     void setScrollBarPosition(QTermWidgetInterface::ScrollBarPosition) override;
 
@@ -154,6 +167,57 @@ public:
      */
     void setFlowControlWarningEnabled(bool enabled) override;
 
+    /**
+     * Sets whether output of the shell program is read from the pty on a
+     * dedicated I/O thread, so that a busy GUI does not throttle it.
+     * Disabled by default.
+     */
+    void setThreadedPtyReading(bool threaded);
+    bool threadedPtyReading() const;
+
+    /**
+     * Sets whether the output of the shell program is parsed and applied
+     * to the terminal screen on a worker thread of this terminal, while
+     * the widget paints snapshots of the screen.  Useful with many busy
+     * terminals in one window.  Disabled by default.
+     *
+     * Not supported together with startTerminalTeletype().
+     */
+    void setThreadedEmulation(bool threaded);
+    bool threadedEmulation() const;
+
+    /**
+     * Records the output of the shell program and the changes of the
+     * terminal size to @p fileName, with timestamps and periodic keyframes
+     * of the screen, until stopRecording() is called.  The recording can
+     * be played back with Konsole::TerminalReplayer, e.g. into a
+     * Konsole::HeadlessSession.  Returns false if the file could not be
+     * written.
+     */
+    bool startRecording(const QString& fileName);
+    void stopRecording();
+    bool isRecording() const;
+
+    /**
+     * Sets whether the terminal favors latency or throughput when it
+     * updates after output of the shell program.  With the default,
+     * UpdatePolicy::LowLatency, typed characters are shown as soon as they
+     * are echoed and floods of output at the refresh rate of the screen.
+     * UpdatePolicy::HighThroughput collects output for longer and paints
+     * less often.
+     */
+    void setUpdatePolicy(UpdatePolicy policy);
+    UpdatePolicy updatePolicy() const;
+
+    /**
+     * Installs a callback which is handed every block of output of the
+     * shell program as raw bytes, without any conversion or copy.  The data
+     * is only valid for the duration of the call.  Pass an empty function
+     * to remove it.  This is cheaper than receivedData() for embedders which
+     * log or record the output.
+     */
+    void setRawOutputTap(const std::function<void(QByteArrayView data)>& tap);
+
     /*! Get all available keyboard bindings
      */
     static QStringList availableKeyBindings();
@@ -292,7 +356,8 @@ signals:
 
     /**
      * Signals that we received new data from the process running in the
-     * terminal emulator
+     * terminal emulator.  The data is only converted to text while this
+     * signal is connected.
      */
     void receivedData(const QString &text);
 
@@ -329,6 +394,8 @@ public slots:
 
 protected:
     void resizeEvent(QResizeEvent *) override;
+    void connectNotify(const QMetaMethod &signal) override;
+    void disconnectNotify(const QMetaMethod &signal) override;
 
 protected slots:
     void sessionFinished();